@@ -0,0 +1,288 @@
+// Host benchmark for the firmware hot path.
+// Each native env in platformio.ini builds this against one model; run them
+// all with `make bench`. Host ns/iter tracks the cost of our own code, device
+// us/iter is the time the shim charged for hardware waits (show(), PTC).
+// Left out of unit test builds, which link the firmware and bring their own main().
+#ifndef PIO_UNIT_TESTING
+#include <Arduino.h>
+#include <hal_native.h>
+#include <models.h>
+#include <keycodes.h>
+#include <macro.h>
+#include <matrix.h>
+#include <color.h>
+#include <Adafruit_NeoPixel.h>
+#include <stdio.h>
+#include <chrono>
+
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+void checkKeys();
+void keyboard();
+void effects(uint8_t speed, uint8_t MODE);
+void settingsLoad();
+void settingsSave();
+void legacyDispatch(uint8_t code, bool released);
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint32_t iterations = 100000;
+// Virtual time between iterations, roughly one loop() on hardware
+static const uint32_t stepMicros = 125;
+
+// Toggle one pin/pad every few iterations so every stage sees real edges
+static void stimulus(uint32_t i) {
+    if (i % 16) return;
+    uint8_t pin = (i / 16) % 11;
+    bool level = !hal::getPin(pin);
+    hal::setPin(pin, level);
+    hal::setTouch(pin, level ? 700 : 1000);
+}
+
+static void noop() {}
+
+// Cost of reading the clock twice, subtracted from every sample
+static double clockOverheadNs;
+
+static void calibrate() {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        Clock::time_point t0 = Clock::now();
+        Clock::time_point t1 = Clock::now();
+        total += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    }
+    clockOverheadNs = (double)total / iterations;
+}
+
+// Time fn() alone; prep() runs untimed before it on every iteration
+template <typename Prep, typename Fn>
+static void stage(const char *name, Prep prep, Fn fn) {
+    hal::reset();
+    setup();
+    uint64_t hostNs = 0;
+    uint64_t deviceMicros = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        stimulus(i);
+        hal::advance(stepMicros);
+        prep();
+        uint64_t start = hal::now();
+        Clock::time_point t0 = Clock::now();
+        fn();
+        Clock::time_point t1 = Clock::now();
+        deviceMicros += hal::now() - start;
+        hostNs += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    }
+    double ns = (double)hostNs / iterations - clockOverheadNs;
+    printf("%-14s %-12s %10.1f ns/iter %10.2f us/iter device\n", XSTR(MODEL), name,
+            ns > 0 ? ns : 0, (double)deviceMicros / iterations);
+}
+
+// Old switch against the compiled table, for every configurator code
+static const uint16_t numCodes = 200;
+static KeyAction actions[numCodes];
+
+static bool sameReports(const std::vector<hal::Report> &a, const std::vector<hal::Report> &b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (memcmp(a[i].keys, b[i].keys, sizeof(a[i].keys)) || a[i].buttons != b[i].buttons) return false;
+    }
+    return true;
+}
+
+template <typename Fn>
+static void dispatchStage(const char *name, Fn fn) {
+    const uint32_t reps = 2000;
+    double total = 0;
+    double worst = 0;
+    uint16_t worstCode = 0;
+    hal::setUsbBusy(true);
+    for (uint16_t code = 0; code < numCodes; code++) {
+        Clock::time_point t0 = Clock::now();
+        for (uint32_t i = 0; i < reps; i++) {
+            fn(code, true);
+            fn(code, false);
+        }
+        Clock::time_point t1 = Clock::now();
+        double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / (reps * 2);
+        total += ns;
+        if (ns > worst) { worst = ns; worstCode = code; }
+    }
+    hal::setUsbBusy(false);
+    printf("%-14s %-12s %10.1f ns/key  %10.1f ns worst (code %u)\n", XSTR(MODEL), name,
+            total / numCodes, worst, worstCode);
+}
+
+static bool dispatchBench() {
+    for (uint16_t code = 0; code < numCodes; code++) actions[code] = compileKey(code);
+    // Both paths have to send the same reports before timing means anything
+    for (uint16_t code = 0; code < numCodes; code++) {
+        hal::reset();
+        legacyDispatch(code, false);
+        legacyDispatch(code, true);
+        std::vector<hal::Report> legacy = hal::reports();
+        hal::reset();
+        dispatchKey(actions[code], true);
+        flushReports();
+        dispatchKey(actions[code], false);
+        flushReports();
+        if (!sameReports(legacy, hal::reports())) {
+            printf("dispatch mismatch for code %u\n", code);
+            return false;
+        }
+    }
+    dispatchStage("switch", [](uint16_t code, bool press) { legacyDispatch(code, !press); });
+    dispatchStage("table", [](uint16_t code, bool press) { dispatchKey(actions[code], press); flushReports(); });
+    return true;
+}
+
+// Old per-pixel ColorHSV() against the color tables, for one frame. "full"
+// is every pixel at full saturation (wheel, custom, bps), "fade" has them
+// mid-fade like rbFade.
+template <typename Fn>
+static void colorStage(const char *name, bool fade, Fn fn) {
+    const uint32_t frames = 100000;
+    volatile uint32_t sink = 0;
+    Clock::time_point t0 = Clock::now();
+    for (uint32_t f = 0; f < frames; f++) {
+        for (uint8_t i = 0; i < numleds; i++) {
+            uint8_t sat = fade ? (f * 8 + i) & 0xff : 255;
+            uint8_t val = fade ? 255 - (f & 0xff) : 255;
+            sink = sink + fn(f + i * 50, sat, val);
+        }
+    }
+    Clock::time_point t1 = Clock::now();
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / frames;
+    printf("%-14s %-12s %10.1f ns/frame  %s, %u LEDs\n", XSTR(MODEL), name, ns, fade ? "fade" : "full", numleds);
+}
+
+static bool colorBench() {
+    const uint8_t b = 127;
+    colorBrightness(b);
+    // The tables have to give the same colors (within rounding) first
+#ifndef LED_GAMMA
+    for (uint16_t hue = 0; hue < 256; hue++) {
+        for (uint16_t sat = 0; sat < 256; sat += 5) {
+            for (uint16_t val = 0; val < 256; val += 5) {
+                uint32_t a = Adafruit_NeoPixel::ColorHSV(hue * 256, sat, val * b / 255);
+                uint32_t c = ledColor(hue, sat, val);
+                for (uint8_t shift = 0; shift < 24; shift += 8) {
+                    if (abs((int)((a >> shift) & 0xff) - (int)((c >> shift) & 0xff)) > 2) {
+                        printf("color mismatch for hue %u sat %u val %u\n", hue, sat, val);
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+#endif
+    auto before = [](uint8_t hue, uint8_t sat, uint8_t val) {
+        return Adafruit_NeoPixel::ColorHSV(hue * 256, sat, val * b / 255);
+    };
+    auto after = [](uint8_t hue, uint8_t sat, uint8_t val) { return ledColor(hue, sat, val); };
+    colorStage("ColorHSV", false, before);
+    colorStage("colorTable", false, after);
+    colorStage("ColorHSV", true, before);
+    colorStage("colorTable", true, after);
+    return true;
+}
+
+// Macro table use and playback, one report per USB frame. A macro costs
+// its bytes in the table (which is also what the settings log stores) and
+// the player's state is shared by all of them.
+static bool macroBench() {
+    const uint8_t table[MACRO_BYTES] = {
+        MACRO_CTRL, MACRO_ALT, 169, MACRO_END,                                          // ctrl+alt+delete
+        'h', 'e', 'l', 'l', 'o', MACRO_END,                                             // hello
+        MACRO_GUI, 'r', MACRO_WAIT, 20, 'n', 'o', 't', 'e', 'p', 'a', 'd', 161, MACRO_END // win+r notepad enter
+    };
+    const char *names[] = { "chord", "text", "launch" };
+    for (uint8_t n = 0; n < 3; n++) {
+        hal::reset();
+        hal::clearReports();
+        MacroPlayer player = {};
+        macroQueued = firstMacro + n;
+        uint32_t steps = 0;
+        uint64_t start = hal::now();
+        Clock::time_point t0 = Clock::now();
+        do {
+            macroStep(player, table, millis());
+            flushReports();
+            hal::advance(1000);
+            steps++;
+        } while (player.playing);
+        Clock::time_point t1 = Clock::now();
+        double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / steps;
+        printf("%-14s %-12s %10.1f ns/step  %2u bytes, %2u reports, %3u ms\n", XSTR(MODEL), names[n], ns,
+                macroFind(table, n + 1) - macroFind(table, n), (unsigned)hal::reports().size(),
+                (unsigned)((hal::now() - start) / 1000));
+        // The chord has to go out as one report
+        const hal::Report &r = hal::reports()[0];
+        if (n == 0 && !(r.key(KEY_LEFT_CTRL) && r.key(KEY_LEFT_ALT) && r.key(KEY_DELETE))) {
+            printf("macro chord not in one report\n");
+            return false;
+        }
+    }
+    printf("%-14s macro RAM    %u table + %u player bytes\n", XSTR(MODEL), MACRO_BYTES, (unsigned)sizeof(MacroPlayer));
+    return true;
+}
+
+#ifdef MATRIX
+// Matrix scan time against size, on the first rows+cols pins. Device time
+// is the settle wait on each row; matrix.h has the targets.
+static bool matrixBench() {
+    const uint8_t sizes[][2] = { { 2, 2 }, { 3, 3 }, { 4, 4 }, { 4, 8 } };
+    for (const auto &size : sizes) {
+        uint8_t numRows = size[0], numCols = size[1];
+        uint8_t rowPins[4] = {}, colPins[8] = {};
+        MatrixLine rowLines[4], colLines[8];
+        for (uint8_t r = 0; r < numRows; r++) rowPins[r] = r;
+        for (uint8_t c = 0; c < numCols; c++) colPins[c] = numRows + c;
+        hal::reset();
+        matrixBegin(rowPins, rowLines, numRows, colPins, colLines, numCols);
+        // A rectangle's fourth corner reads as held and has to be caught
+        hal::setSwitch(rowPins[0], colPins[0], true);
+        hal::setSwitch(rowPins[0], colPins[1], true);
+        hal::setSwitch(rowPins[1], colPins[0], true);
+        uint32_t raw = matrixScan(rowLines, numRows, colLines, numCols);
+        uint32_t ghost = 1ul << (numCols + 1);
+        if (!(raw & ghost) || !(matrixGhosts(raw, numRows, numCols) & ghost)) {
+            printf("matrix %ux%u ghost not found\n", numRows, numCols);
+            return false;
+        }
+        const uint32_t scans = 10000;
+        volatile uint32_t sink = 0;
+        uint64_t start = hal::now();
+        Clock::time_point t0 = Clock::now();
+        for (uint32_t i = 0; i < scans; i++) {
+            uint32_t keys = matrixScan(rowLines, numRows, colLines, numCols);
+            sink = sink + matrixGhosts(keys, numRows, numCols);
+        }
+        Clock::time_point t1 = Clock::now();
+        double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / scans;
+        printf("%-14s matrix %ux%-4u %10.1f ns/scan %10.2f us/scan device\n", XSTR(MODEL), numRows, numCols,
+                ns, (double)(hal::now() - start) / scans);
+    }
+    return true;
+}
+#else
+static bool matrixBench() { return true; }
+#endif
+
+int main() {
+    calibrate();
+    // Effects only render once their interval has passed
+    auto frame = [] { hal::advance(11000); };
+    stage("checkKeys", noop, checkKeys);
+    stage("keyboard", checkKeys, keyboard);
+    stage("wheel", frame, [] { effects(10, 0); });
+    stage("rbFade", frame, [] { effects(10, 1); });
+    stage("custom", frame, [] { effects(10, 2); });
+    stage("bps", frame, [] { effects(10, 3); });
+    stage("settingsLoad", noop, settingsLoad);
+    stage("settingsSave", noop, settingsSave);
+    stage("loop", noop, loop);
+    bool ok = dispatchBench() && macroBench() && matrixBench();
+    return colorBench() && ok ? 0 : 1;
+}
+#endif
@@ -0,0 +1,84 @@
+// The switch keyboard() used before the keymap was compiled into a table,
+// kept only so bench.cpp can compare the two dispatch paths.
+#include <keycodes.h>
+
+#define KBP NKROKeyboard.press
+#define KBR NKROKeyboard.release
+
+void legacyDispatch(uint8_t code, bool released) {
+    switch(code){
+        case 128: if (!released) KBP(KEY_LEFT_CTRL); if (released) KBR(KEY_LEFT_CTRL); break;
+        case 129: if (!released) KBP(KEY_LEFT_SHIFT); if (released) KBR(KEY_LEFT_SHIFT); break;
+        case 130: if (!released) KBP(KEY_LEFT_ALT); if (released) KBR(KEY_LEFT_ALT); break;
+        case 131: if (!released) KBP(KEY_LEFT_GUI); if (released) KBR(KEY_LEFT_GUI); break;
+        case 132: if (!released) KBP(KEY_RIGHT_CTRL); if (released) KBR(KEY_RIGHT_CTRL); break;
+        case 133: if (!released) KBP(KEY_RIGHT_SHIFT); if (released) KBR(KEY_RIGHT_SHIFT); break;
+        case 134: if (!released) KBP(KEY_RIGHT_ALT); if (released) KBR(KEY_RIGHT_ALT); break;
+        case 135: if (!released) KBP(KEY_RIGHT_GUI); if (released) KBR(KEY_RIGHT_GUI); break;
+        case 136: if (!released) KBP(KEY_ESC); if (released) KBR(KEY_ESC); break;
+        case 137: if (!released) KBP(KEY_F1); if (released) KBR(KEY_F1); break;
+        case 138: if (!released) KBP(KEY_F2); if (released) KBR(KEY_F2); break;
+        case 139: if (!released) KBP(KEY_F3); if (released) KBR(KEY_F3); break;
+        case 140: if (!released) KBP(KEY_F4); if (released) KBR(KEY_F4); break;
+        case 141: if (!released) KBP(KEY_F5); if (released) KBR(KEY_F5); break;
+        case 142: if (!released) KBP(KEY_F6); if (released) KBR(KEY_F6); break;
+        case 143: if (!released) KBP(KEY_F7); if (released) KBR(KEY_F7); break;
+        case 144: if (!released) KBP(KEY_F8); if (released) KBR(KEY_F8); break;
+        case 145: if (!released) KBP(KEY_F9); if (released) KBR(KEY_F9); break;
+        case 146: if (!released) KBP(KEY_F10); if (released) KBR(KEY_F10); break;
+        case 147: if (!released) KBP(KEY_F11); if (released) KBR(KEY_F11); break;
+        case 148: if (!released) KBP(KEY_F12); if (released) KBR(KEY_F12); break;
+        case 149: if (!released) KBP(KEY_F13); if (released) KBR(KEY_F13); break;
+        case 150: if (!released) KBP(KEY_F14); if (released) KBR(KEY_F14); break;
+        case 151: if (!released) KBP(KEY_F15); if (released) KBR(KEY_F15); break;
+        case 152: if (!released) KBP(KEY_F16); if (released) KBR(KEY_F16); break;
+        case 153: if (!released) KBP(KEY_F17); if (released) KBR(KEY_F17); break;
+        case 154: if (!released) KBP(KEY_F18); if (released) KBR(KEY_F18); break;
+        case 155: if (!released) KBP(KEY_F19); if (released) KBR(KEY_F19); break;
+        case 156: if (!released) KBP(KEY_F20); if (released) KBR(KEY_F20); break;
+        case 157: if (!released) KBP(KEY_F21); if (released) KBR(KEY_F21); break;
+        case 158: if (!released) KBP(KEY_F22); if (released) KBR(KEY_F22); break;
+        case 159: if (!released) KBP(KEY_F23); if (released) KBR(KEY_F23); break;
+        case 160: if (!released) KBP(KEY_F24); if (released) KBR(KEY_F24); break;
+        case 161: if (!released) KBP(KEY_ENTER); if (released) KBR(KEY_ENTER); break;
+        case 162: if (!released) KBP(KEY_BACKSPACE); if (released) KBR(KEY_BACKSPACE); break;
+        case 163: if (!released) KBP(KEY_TAB); if (released) KBR(KEY_TAB); break;
+        case 164: if (!released) KBP(KEY_PRINT); if (released) KBR(KEY_PRINT); break;
+        case 165: if (!released) KBP(KEY_PAUSE); if (released) KBR(KEY_PAUSE); break;
+        case 166: if (!released) KBP(KEY_INSERT); if (released) KBR(KEY_INSERT); break;
+        case 167: if (!released) KBP(KEY_HOME); if (released) KBR(KEY_HOME); break;
+        case 168: if (!released) KBP(KEY_PAGE_UP); if (released) KBR(KEY_PAGE_UP); break;
+        case 169: if (!released) KBP(KEY_DELETE); if (released) KBR(KEY_DELETE); break;
+        case 170: if (!released) KBP(KEY_END); if (released) KBR(KEY_END); break;
+        case 171: if (!released) KBP(KEY_PAGE_DOWN); if (released) KBR(KEY_PAGE_DOWN); break;
+        case 172: if (!released) KBP(KEY_RIGHT); if (released) KBR(KEY_RIGHT); break;
+        case 173: if (!released) KBP(KEY_LEFT); if (released) KBR(KEY_LEFT); break;
+        case 174: if (!released) KBP(KEY_DOWN); if (released) KBR(KEY_DOWN); break;
+        case 175: if (!released) KBP(KEY_UP); if (released) KBR(KEY_UP); break;
+        case 176: if (!released) KBP(KEYPAD_DIVIDE); if (released) KBR(KEYPAD_DIVIDE); break;
+        case 177: if (!released) KBP(KEYPAD_MULTIPLY); if (released) KBR(KEYPAD_MULTIPLY); break;
+        case 178: if (!released) KBP(KEYPAD_SUBTRACT); if (released) KBR(KEYPAD_SUBTRACT); break;
+        case 179: if (!released) KBP(KEYPAD_ADD); if (released) KBR(KEYPAD_ADD); break;
+        case 180: if (!released) KBP(KEYPAD_ENTER); if (released) KBR(KEYPAD_ENTER); break;
+        case 181: if (!released) KBP(KEYPAD_1); if (released) KBR(KEYPAD_1); break;
+        case 182: if (!released) KBP(KEYPAD_2); if (released) KBR(KEYPAD_2); break;
+        case 183: if (!released) KBP(KEYPAD_3); if (released) KBR(KEYPAD_3); break;
+        case 184: if (!released) KBP(KEYPAD_4); if (released) KBR(KEYPAD_4); break;
+        case 185: if (!released) KBP(KEYPAD_5); if (released) KBR(KEYPAD_5); break;
+        case 186: if (!released) KBP(KEYPAD_6); if (released) KBR(KEYPAD_6); break;
+        case 187: if (!released) KBP(KEYPAD_7); if (released) KBR(KEYPAD_7); break;
+        case 188: if (!released) KBP(KEYPAD_8); if (released) KBR(KEYPAD_8); break;
+        case 189: if (!released) KBP(KEYPAD_9); if (released) KBR(KEYPAD_9); break;
+        case 190: if (!released) KBP(KEYPAD_0); if (released) KBR(KEYPAD_0); break;
+        case 191: if (!released) KBP(KEY_MENU); if (released) KBR(KEY_MENU); break;
+        case 192: if (!released) KBP(KEY_VOLUME_MUTE); if (released) KBR(KEY_VOLUME_MUTE); break;
+        case 193: if (!released) KBP(KEY_VOLUME_UP); if (released) KBR(KEY_VOLUME_UP); break;
+        case 194: if (!released) KBP(KEY_VOLUME_DOWN); if (released) KBR(KEY_VOLUME_DOWN); break;
+        case 195: if (!released) Mouse.press(MOUSE_LEFT); if (released) Mouse.release(MOUSE_LEFT); break;
+        case 196: if (!released) Mouse.press(MOUSE_RIGHT); if (released) Mouse.release(MOUSE_RIGHT); break;
+        case 197: if (!released) Mouse.press(MOUSE_MIDDLE); if (released) Mouse.release(MOUSE_MIDDLE); break;
+        case 198: if (!released) Mouse.press(MOUSE_PREV); if (released) Mouse.release(MOUSE_PREV); break;
+        case 199: if (!released) Mouse.press(MOUSE_NEXT); if (released) Mouse.release(MOUSE_NEXT); break;
+        default: if (!released) KBP(code); if (released) KBR(code); break;
+    }
+}
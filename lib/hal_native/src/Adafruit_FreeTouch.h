@@ -0,0 +1,21 @@
+// Host version of Adafruit_FreeTouch.
+// measure() runs one conversion through the PTC shim and waits for it, so it
+// charges the virtual clock with the conversion time of the oversampling.
+#pragma once
+
+#include <adafruit_ptc.h>
+
+class Adafruit_FreeTouch {
+public:
+    Adafruit_FreeTouch(int p = 0, oversample_t f = OVERSAMPLE_4,
+            series_resistor_t r = RESISTOR_0, freq_mode_t fh = FREQ_MODE_NONE)
+        : pin(p), oversample(f), seriesres(r), freqhop(fh) {}
+    bool begin() { return true; }
+    uint16_t measure();
+    uint16_t measureRaw() { return measure(); }
+private:
+    int pin;
+    oversample_t oversample;
+    series_resistor_t seriesres;
+    freq_mode_t freqhop;
+};
@@ -0,0 +1,38 @@
+// Host version of Adafruit_NeoPixel.
+// show() charges the virtual clock with the wire time of the strip, since
+// the real one bit-bangs with interrupts off for that long.
+#pragma once
+
+#include <Arduino.h>
+
+typedef uint16_t neoPixelType;
+
+#define NEO_RGB ((0 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_GRB ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_RGBW ((3 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_GRBW ((3 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_KHZ800 0x0000
+
+class Adafruit_NeoPixel {
+public:
+    Adafruit_NeoPixel(uint16_t n, int16_t pin = 6, neoPixelType type = NEO_GRB + NEO_KHZ800);
+    ~Adafruit_NeoPixel();
+    void begin() {}
+    void show();
+    void clear() { memset(pixels, 0, numBytes); }
+    void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b);
+    void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b, uint8_t w);
+    void setPixelColor(uint16_t n, uint32_t c);
+    uint32_t getPixelColor(uint16_t n) const;
+    uint8_t *getPixels() const { return pixels; }
+    uint16_t numPixels() const { return numLEDs; }
+    static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+        return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+    }
+    static uint32_t ColorHSV(uint16_t hue, uint8_t sat = 255, uint8_t val = 255);
+private:
+    uint16_t numLEDs;
+    uint16_t numBytes;
+    uint8_t *pixels;
+    int8_t rOffset, gOffset, bOffset, wOffset;
+};
@@ -0,0 +1,97 @@
+// Minimal Arduino core for host builds.
+// Only what the firmware actually uses is here; time is virtual and driven
+// by the bench/test harness through hal_native.h.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <hal_registers.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 2
+#define FALLING 3
+#define RISING 4
+
+// Pin numbers match the XIAO and QT Py variants
+#define A0 0
+#define A1 1
+#define A2 2
+#define A3 3
+#define A4 4
+#define A5 5
+#define A6 6
+#define A7 7
+#define A8 8
+#define A9 9
+#define A10 10
+#define PIN_NEOPIXEL 11
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+typedef void (*voidFuncPtr)(void);
+void attachInterrupt(uint32_t pin, voidFuncPtr callback, uint32_t mode);
+void detachInterrupt(uint32_t pin);
+inline bool isDigit(int c) { return c >= '0' && c <= '9'; }
+
+void setup();
+void loop();
+
+// Flash strings are plain strings on the host
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+// No String: the firmware doesn't allocate after setup(), so a host build
+// fails if one creeps back in
+
+#define DEC 10
+#define HEX 16
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t size);
+    size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+    size_t print(const __FlashStringHelper *s) { return write((const char *)s); }
+    size_t print(const char *s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(int n, int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+    template <typename T> size_t println(T v, int base) { size_t n = print(v, base); return n + println(); }
+    size_t println() { return write("\r\n"); }
+};
+
+class Serial_ : public Print {
+public:
+    void begin(unsigned long) {}
+    int available();
+    int read();
+    int peek();
+    int availableForWrite();
+    void flush() {}
+    bool dtr();
+    operator bool() { return dtr(); }
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buf, size_t size) override;
+    using Print::write;
+};
+extern Serial_ Serial;
@@ -0,0 +1,24 @@
+// Host version of FlashStorage's EEPROM emulation.
+// commit() counts as one erase/write of every flash row backing the buffer.
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef EEPROM_EMULATION_SIZE
+#define EEPROM_EMULATION_SIZE 1024
+#endif
+
+class EEPROMClass {
+public:
+    uint8_t read(int address) { return buffer[address]; }
+    void write(int address, uint8_t value) { buffer[address] = value; dirty = true; }
+    void update(int address, uint8_t value) { if (buffer[address] != value) write(address, value); }
+    bool isValid() { return valid; }
+    void commit();
+private:
+    friend void halEepromReset();
+    uint8_t buffer[EEPROM_EMULATION_SIZE];
+    bool valid;
+    bool dirty;
+};
+extern EEPROMClass EEPROM;
@@ -0,0 +1,33 @@
+// Host version of FlashStorage's FlashClass.
+// Each instance keeps its own copy of the flash it was given, since the
+// real region is a const array the host can't write. Writes can only clear
+// bits, like NOR flash, and erases are counted per row.
+#pragma once
+
+#include <Arduino.h>
+
+#define FLASH_ROW_SIZE 256
+
+class FlashClass {
+public:
+    FlashClass(const void *flash_addr = NULL, uint32_t size = 0);
+    ~FlashClass();
+    void write(const void *data) { write(flash_address, data, flash_size); }
+    void erase() { erase(flash_address, flash_size); }
+    void read(void *data) { read(flash_address, data, flash_size); }
+    void write(const volatile void *flash_ptr, const void *data, uint32_t size);
+    void erase(const volatile void *flash_ptr, uint32_t size);
+    void read(const volatile void *flash_ptr, void *data, uint32_t size);
+private:
+    friend void halFlashReset();
+    uint8_t *at(const volatile void *flash_ptr, uint32_t size);
+    const volatile void *flash_address;
+    const uint32_t flash_size;
+    uint8_t *memory;
+    FlashClass *nextFlash;
+};
+
+#define Flash(name, size) \
+    __attribute__((__aligned__(256))) \
+    static const uint8_t _data##name[(size + 255) / 256 * 256] = { }; \
+    FlashClass name(_data##name, size);
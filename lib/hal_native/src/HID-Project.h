@@ -0,0 +1,116 @@
+// Host version of the HID-Project NKRO keyboard and mouse APIs.
+// Every report that would go out on the endpoint is appended to the
+// report log in hal_native.h instead.
+#pragma once
+
+#include <Arduino.h>
+
+enum KeyboardKeycode : uint8_t {
+    KEY_RESERVED = 0x00,
+    KEY_ENTER = 0x28,
+    KEY_ESC = 0x29,
+    KEY_BACKSPACE = 0x2A,
+    KEY_TAB = 0x2B,
+    KEY_SPACE = 0x2C,
+    KEY_F1 = 0x3A,
+    KEY_F2 = 0x3B,
+    KEY_F3 = 0x3C,
+    KEY_F4 = 0x3D,
+    KEY_F5 = 0x3E,
+    KEY_F6 = 0x3F,
+    KEY_F7 = 0x40,
+    KEY_F8 = 0x41,
+    KEY_F9 = 0x42,
+    KEY_F10 = 0x43,
+    KEY_F11 = 0x44,
+    KEY_F12 = 0x45,
+    KEY_PRINT = 0x46,
+    KEY_PAUSE = 0x48,
+    KEY_INSERT = 0x49,
+    KEY_HOME = 0x4A,
+    KEY_PAGE_UP = 0x4B,
+    KEY_DELETE = 0x4C,
+    KEY_END = 0x4D,
+    KEY_PAGE_DOWN = 0x4E,
+    KEY_RIGHT = 0x4F,
+    KEY_LEFT = 0x50,
+    KEY_DOWN = 0x51,
+    KEY_UP = 0x52,
+    KEYPAD_DIVIDE = 0x54,
+    KEYPAD_MULTIPLY = 0x55,
+    KEYPAD_SUBTRACT = 0x56,
+    KEYPAD_ADD = 0x57,
+    KEYPAD_ENTER = 0x58,
+    KEYPAD_1 = 0x59,
+    KEYPAD_2 = 0x5A,
+    KEYPAD_3 = 0x5B,
+    KEYPAD_4 = 0x5C,
+    KEYPAD_5 = 0x5D,
+    KEYPAD_6 = 0x5E,
+    KEYPAD_7 = 0x5F,
+    KEYPAD_8 = 0x60,
+    KEYPAD_9 = 0x61,
+    KEYPAD_0 = 0x62,
+    KEY_F13 = 0x68,
+    KEY_F14 = 0x69,
+    KEY_F15 = 0x6A,
+    KEY_F16 = 0x6B,
+    KEY_F17 = 0x6C,
+    KEY_F18 = 0x6D,
+    KEY_F19 = 0x6E,
+    KEY_F20 = 0x6F,
+    KEY_F21 = 0x70,
+    KEY_F22 = 0x71,
+    KEY_F23 = 0x72,
+    KEY_F24 = 0x73,
+    KEY_MENU = 0x76,
+    KEY_VOLUME_MUTE = 0x7F,
+    KEY_VOLUME_UP = 0x80,
+    KEY_VOLUME_DOWN = 0x81,
+    KEY_LEFT_CTRL = 0xE0,
+    KEY_LEFT_SHIFT = 0xE1,
+    KEY_LEFT_ALT = 0xE2,
+    KEY_LEFT_GUI = 0xE3,
+    KEY_RIGHT_CTRL = 0xE4,
+    KEY_RIGHT_SHIFT = 0xE5,
+    KEY_RIGHT_ALT = 0xE6,
+    KEY_RIGHT_GUI = 0xE7,
+};
+
+#define MOUSE_LEFT 0x01
+#define MOUSE_RIGHT 0x02
+#define MOUSE_MIDDLE 0x04
+#define MOUSE_PREV 0x08
+#define MOUSE_NEXT 0x10
+
+class NKROKeyboard_ {
+public:
+    void begin() { releaseAll(); }
+    size_t add(KeyboardKeycode k);
+    size_t remove(KeyboardKeycode k);
+    // ASCII input goes through the US layout like the real library
+    size_t add(uint8_t k);
+    size_t remove(uint8_t k);
+    int send();
+    size_t press(KeyboardKeycode k) { size_t r = add(k); if (r) send(); return r; }
+    size_t release(KeyboardKeycode k) { size_t r = remove(k); if (r) send(); return r; }
+    size_t press(uint8_t k) { size_t r = add(k); if (r) send(); return r; }
+    size_t release(uint8_t k) { size_t r = remove(k); if (r) send(); return r; }
+    size_t releaseAll() { memset(keys, 0, sizeof(keys)); return send(); }
+private:
+    uint8_t keys[32];
+};
+extern NKROKeyboard_ NKROKeyboard;
+
+class Mouse_ {
+public:
+    void begin() { buttonState = 0; }
+    void press(uint8_t b = MOUSE_LEFT) { buttons(buttonState | b); }
+    void release(uint8_t b = MOUSE_LEFT) { buttons(buttonState & ~b); }
+    void releaseAll() { buttons(0); }
+    bool isPressed(uint8_t b = MOUSE_LEFT) { return (buttonState & b) != 0; }
+private:
+    void buttons(uint8_t b);
+    uint8_t buttonState;
+};
+extern Mouse_ Mouse;
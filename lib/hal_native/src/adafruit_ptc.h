@@ -0,0 +1,55 @@
+// Host version of the PTC driver underneath Adafruit_FreeTouch.
+// One conversion runs at a time; it finishes once the virtual clock has
+// moved past its conversion time, and the result is the oversampled sum.
+#pragma once
+
+#include <Arduino.h>
+
+typedef enum {
+    OVERSAMPLE_1,
+    OVERSAMPLE_2,
+    OVERSAMPLE_4,
+    OVERSAMPLE_8,
+    OVERSAMPLE_16,
+    OVERSAMPLE_32,
+    OVERSAMPLE_64,
+} oversample_t;
+
+typedef enum {
+    RESISTOR_0,
+    RESISTOR_20K,
+    RESISTOR_50K,
+    RESISTOR_100K,
+} series_resistor_t;
+
+typedef enum {
+    FREQ_MODE_NONE,
+    FREQ_MODE_HOP,
+    FREQ_MODE_SPREAD,
+    FREQ_MODE_SPREAD_MEDIAN,
+} freq_mode_t;
+
+typedef enum {
+    FREQ_HOP_1,
+} freq_hop_t;
+
+struct adafruit_ptc_config {
+    uint8_t pin;
+    int8_t yline;
+    oversample_t oversample;
+    series_resistor_t seriesres;
+    freq_mode_t freqhop;
+    freq_hop_t hops;
+    uint16_t compcap;
+    uint8_t intcap;
+};
+
+typedef struct { uint8_t reserved; } Ptc;
+extern Ptc hal_ptc;
+#define PTC (&hal_ptc)
+
+void adafruit_ptc_get_config_default(struct adafruit_ptc_config *config);
+void adafruit_ptc_init(Ptc *module_inst, struct adafruit_ptc_config const *config);
+void adafruit_ptc_start_conversion(Ptc *module_inst, struct adafruit_ptc_config const *config);
+bool adafruit_ptc_is_conversion_finished(Ptc *module_inst);
+uint16_t adafruit_ptc_get_conversion_result(Ptc *module_inst);
@@ -0,0 +1,637 @@
+#include <Arduino.h>
+#include <HID-Project.h>
+#include <Adafruit_NeoPixel.h>
+#include <Adafruit_FreeTouch.h>
+#include <FlashAsEEPROM.h>
+#include <FlashStorage.h>
+#include <wiring_private.h>
+#include <hal_native.h>
+#include <deque>
+
+// Variant pin tables
+#ifdef ADAFRUIT_QTPY_M0
+const PinDescription g_APinDescription[] = {
+    { PORTA, 2 }, { PORTA, 3 }, { PORTA, 4 }, { PORTA, 5 }, { PORTA, 16 },
+    { PORTA, 17 }, { PORTA, 6 }, { PORTA, 7 }, { PORTA, 11 }, { PORTA, 9 },
+    { PORTA, 10 }, { PORTA, 18 }, { PORTA, 15 }, { PORTA, 19 },
+};
+#else
+const PinDescription g_APinDescription[] = {
+    { PORTA, 2 }, { PORTA, 4 }, { PORTA, 10 }, { PORTA, 11 }, { PORTA, 8 },
+    { PORTA, 9 }, { PORTB, 8 }, { PORTB, 9 }, { PORTA, 7 }, { PORTA, 5 },
+    { PORTA, 6 }, { PORTA, 18 }, { PORTA, 19 }, { PORTA, 17 },
+};
+#endif
+static const uint8_t numPins = sizeof(g_APinDescription) / sizeof(g_APinDescription[0]);
+
+Port hal_port;
+Gclk hal_gclk;
+Tc hal_tc3;
+Ptc hal_ptc;
+Pm hal_pm;
+Sercom hal_sercom[6];
+Dmac hal_dmac;
+Usb hal_usb;
+Serial_ Serial;
+NKROKeyboard_ NKROKeyboard;
+Mouse_ Mouse;
+EEPROMClass EEPROM;
+
+// Virtual clock in CPU cycles
+static const uint32_t cyclesPerMicro = F_CPU / 1000000;
+static uint64_t clockCycles;
+static uint16_t touchRaw[numPins];
+static uint64_t ptcDone;
+static uint16_t ptcResult;
+static std::deque<char> serialIn;
+static std::string serialOut;
+static int serialWritable;
+static int serialSpace;
+static uint64_t serialFrame;
+static bool serialOpen;
+static bool serialTimedOut;
+static bool usbBusy;
+static std::vector<hal::Report> reportLog;
+static uint32_t frames;
+static uint64_t lastShowEnd;
+static std::vector<uint8_t> wire;
+static uint64_t dmaDone;
+static bool tc3Irq;
+static bool irqMasked;
+static bool inHandler;
+static bool tickPending;
+static uint64_t nextTick;
+static uint32_t erases;
+static uint32_t flashPages;
+static FlashClass *flashList;
+// Levels set by the harness, and closed matrix switches as pin pairs
+static uint32_t pinLevel[2];
+static std::vector<std::pair<uint8_t, uint8_t> > switches;
+// Pin change interrupts, see attachInterrupt()
+static voidFuncPtr pinIsr[numPins];
+static uint8_t pinIsrMode[numPins];
+static bool usbSuspended;
+
+// TC3 compare interrupt
+static uint64_t tc3Period() {
+    static const uint16_t prescale[] = { 1, 2, 4, 8, 16, 64, 256, 1024 };
+    const TcCount16 &tc = hal_tc3.COUNT16;
+    return (uint64_t)(tc.CC[0].reg + 1) * prescale[(tc.CTRLA.reg >> 8) & 7];
+}
+
+static bool tc3Armed() {
+    const TcCount16 &tc = hal_tc3.COUNT16;
+    bool armed = tc3Irq && TC3_Handler && (tc.CTRLA.reg & TC_CTRLA_ENABLE) && (tc.INTENSET.reg & TC_INTENSET_MC0);
+    if (!armed) nextTick = 0;
+    else if (!nextTick) nextTick = clockCycles + tc3Period();
+    return armed;
+}
+
+static void fireTc3() {
+    tickPending = false;
+    hal_tc3.COUNT16.INTFLAG.reg |= TC_INTFLAG_MC0;
+    inHandler = true;
+    TC3_Handler();
+    inHandler = false;
+}
+
+// DMA into an SPI data register, one byte per SPI byte time. The transfer
+// starts the first time the clock moves after the channel is enabled.
+static void startDma() {
+    const DmacDescriptor &d = *(const DmacDescriptor *)hal_dmac.BASEADDR.reg;
+    const uint8_t *src = (const uint8_t *)d.SRCADDR.reg - d.BTCNT.reg;
+    uint8_t baud = 0;
+    for (uint8_t x = 0; x < 6; x++) {
+        if (d.DSTADDR.reg == (uintptr_t)&hal_sercom[x].SPI.DATA.reg) baud = hal_sercom[x].SPI.BAUD.reg;
+    }
+    dmaDone = clockCycles + (uint64_t)d.BTCNT.reg * 8 * 2 * (baud + 1);
+    // Pull the LED bytes back out of the SPI bits: 110 is a 1, 100 a 0
+    wire.clear();
+    uint32_t bits = d.BTCNT.reg * 8;
+    uint32_t i = 0;
+    auto bit = [&](uint32_t n) { return (src[n / 8] >> (7 - n % 8)) & 1; };
+    while (i < bits && !bit(i)) i++;
+    uint8_t byte = 0, count = 0;
+    for (; i + 2 < bits && bit(i); i += 3) {
+        byte = (byte << 1) | bit(i + 1);
+        if (++count == 8) { wire.push_back(byte); count = 0; }
+    }
+}
+
+static void serviceDma() {
+    if (!(hal_dmac.CHCTRLA.reg & DMAC_CHCTRLA_ENABLE)) { dmaDone = 0; return; }
+    if (!dmaDone) startDma();
+    if (clockCycles >= dmaDone) {
+        hal_dmac.CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+        dmaDone = 0;
+        frames++;
+    }
+}
+
+// Key matrix without diodes: a pin driven low pulls down everything joined
+// to it through closed switches. Only worked out when the clock moves, so
+// a scan that reads straight after driving a row sees the old levels.
+static void resolveMatrix() {
+    uint32_t low[2] = { 0, 0 };
+    auto pinLow = [&](uint8_t pin) { return (low[g_APinDescription[pin].ulPort] >> g_APinDescription[pin].ulPin) & 1; };
+    auto setLow = [&](uint8_t pin) { low[g_APinDescription[pin].ulPort] |= 1ul << g_APinDescription[pin].ulPin; };
+    for (uint8_t g = 0; g < 2; g++) low[g] = hal_port.Group[g].DIR.reg & ~hal_port.Group[g].OUT.reg;
+    bool spread = true;
+    while (spread) {
+        spread = false;
+        for (const auto &s : switches) {
+            if (pinLow(s.first) != pinLow(s.second)) {
+                setLow(s.first);
+                setLow(s.second);
+                spread = true;
+            }
+        }
+    }
+    for (uint8_t g = 0; g < 2; g++) hal_port.Group[g].IN.reg = pinLevel[g] & ~low[g];
+}
+
+// Move the clock forward, taking timer interrupts on the way. With
+// interrupts masked (or already in the handler) ticks collapse into one
+// late interrupt, like a pending flag on the real NVIC.
+static void run(uint64_t cycles, bool masked = false) {
+    uint64_t end = clockCycles + cycles;
+    bool blocked = masked || irqMasked || inHandler;
+    while (tc3Armed() && nextTick <= end) {
+        clockCycles = nextTick;
+        nextTick += tc3Period();
+        if (blocked) tickPending = true;
+        else fireTc3();
+    }
+    clockCycles = end;
+    if (!usbSuspended) hal_usb.DEVICE.FNUM.bit.FNUM = clockCycles / (1000 * cyclesPerMicro);
+    resolveMatrix();
+    serviceDma();
+    if (tickPending && !irqMasked && !inHandler) fireTc3();
+}
+
+void NVIC_EnableIRQ(IRQn_Type) { tc3Irq = true; }
+void NVIC_DisableIRQ(IRQn_Type) { tc3Irq = false; }
+void NVIC_SetPriority(IRQn_Type, uint32_t) {}
+void NVIC_SetPendingIRQ(IRQn_Type) {
+    if (!tc3Irq || !TC3_Handler) return;
+    tickPending = true;
+    if (!irqMasked && !inHandler) fireTc3();
+}
+void __disable_irq() { irqMasked = true; }
+void __enable_irq() {
+    irqMasked = false;
+    if (tickPending && !inHandler) fireTc3();
+}
+
+void __WFI() {
+    uint64_t ms = 1000 * cyclesPerMicro;
+    uint64_t wake = (clockCycles / ms + 1) * ms;
+    if (tc3Armed() && nextTick < wake) wake = nextTick;
+    run(wake - clockCycles);
+}
+
+// Time
+unsigned long millis() { return clockCycles / cyclesPerMicro / 1000; }
+unsigned long micros() { return (unsigned long)(clockCycles / cyclesPerMicro); }
+void delay(unsigned long ms) { run((uint64_t)ms * 1000 * cyclesPerMicro); }
+void delayMicroseconds(unsigned int us) { run((uint64_t)us * cyclesPerMicro); }
+void yield() {}
+
+// GPIO
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin >= numPins) return;
+    PortGroup &g = hal_port.Group[g_APinDescription[pin].ulPort];
+    uint32_t mask = 1ul << g_APinDescription[pin].ulPin;
+    if (mode == OUTPUT) g.DIR.reg |= mask;
+    else g.DIR.reg &= ~mask;
+    g.PINCFG[g_APinDescription[pin].ulPin].bit.PULLEN = mode == INPUT_PULLUP;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    if (pin >= numPins) return;
+    PortGroup &g = hal_port.Group[g_APinDescription[pin].ulPort];
+    uint32_t mask = 1ul << g_APinDescription[pin].ulPin;
+    if (val) g.OUT.reg |= mask;
+    else g.OUT.reg &= ~mask;
+}
+
+// EIC, one callback per pin and called as soon as the harness moves the pin
+void attachInterrupt(uint32_t pin, voidFuncPtr callback, uint32_t mode) {
+    if (pin >= numPins) return;
+    pinIsr[pin] = callback;
+    pinIsrMode[pin] = mode;
+}
+
+void detachInterrupt(uint32_t pin) {
+    if (pin < numPins) pinIsr[pin] = NULL;
+}
+
+int digitalRead(uint8_t pin) {
+    if (pin >= numPins) return LOW;
+    const PortGroup &g = hal_port.Group[g_APinDescription[pin].ulPort];
+    return (g.IN.reg >> g_APinDescription[pin].ulPin) & 1;
+}
+
+// Print
+size_t Print::write(const uint8_t *buf, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buf++);
+    return n;
+}
+
+size_t Print::print(long n, int base) {
+    if (n < 0 && base == DEC) return print('-') + print((unsigned long)-n, base);
+    return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+    char buf[33];
+    char *p = &buf[sizeof(buf) - 1];
+    *p = 0;
+    do {
+        uint8_t d = n % base;
+        *--p = d < 10 ? '0' + d : 'A' + d - 10;
+        n /= base;
+    } while (n);
+    return write(p);
+}
+
+// Serial
+int Serial_::available() { return serialIn.size(); }
+int Serial_::read() {
+    if (serialIn.empty()) return -1;
+    char c = serialIn.front();
+    serialIn.pop_front();
+    return (uint8_t)c;
+}
+int Serial_::peek() { return serialIn.empty() ? -1 : (uint8_t)serialIn.front(); }
+// The host takes up to serialWritable bytes per 1ms USB frame. Writing
+// more waits for the next frame, or times out after 70ms if the host takes
+// nothing, and then fails straight away until it reads again. Like the
+// SAMD core, availableForWrite() is always a packet whatever the host does
+// and nothing is sent without DTR.
+static const uint32_t serialTimeoutMs = 70;
+
+static void serialRefill() {
+    uint64_t frame = clockCycles / (1000 * cyclesPerMicro);
+    if (frame != serialFrame) {
+        serialFrame = frame;
+        serialSpace = serialWritable;
+    }
+}
+
+int Serial_::availableForWrite() { return 63; }
+
+bool Serial_::dtr() { return serialOpen; }
+
+size_t Serial_::write(uint8_t c) { return write(&c, 1); }
+
+size_t Serial_::write(const uint8_t *buf, size_t size) {
+    if (!serialOpen) return 0;
+    size_t sent = 0;
+    while (sent < size) {
+        serialRefill();
+        if (!serialSpace) {
+            if (serialTimedOut) break;
+            for (uint32_t x = 0; x < serialTimeoutMs && !serialSpace; x++) {
+                run(1000 * cyclesPerMicro);
+                serialRefill();
+            }
+            if (!serialSpace) { serialTimedOut = true; break; }
+        }
+        serialTimedOut = false;
+        size_t n = size - sent < (size_t)serialSpace ? size - sent : serialSpace;
+        serialOut.append((const char *)buf + sent, n);
+        serialSpace -= n;
+        sent += n;
+    }
+    return sent;
+}
+
+// HID
+static const hal::Report blankReport = {};
+
+static bool asciiToUsage(uint8_t c, uint8_t &usage, bool &shift) {
+    static const char shifted[] = "!@#$%^&*()";
+    static const char symbols[] = " -=[]\\#;'`,./";
+    static const char symbolsShifted[] = " _+{}| :\"~<>?";
+    shift = false;
+    if (c >= 'a' && c <= 'z') usage = 0x04 + c - 'a';
+    else if (c >= 'A' && c <= 'Z') { usage = 0x04 + c - 'A'; shift = true; }
+    else if (c >= '1' && c <= '9') usage = 0x1E + c - '1';
+    else if (c == '0') usage = 0x27;
+    else if (c == '\n') usage = KEY_ENTER;
+    else if (c == '\t') usage = KEY_TAB;
+    else if (c == '\b') usage = KEY_BACKSPACE;
+    else if (c && strchr(shifted, c)) { usage = 0x1E + (strchr(shifted, c) - shifted); shift = true; }
+    else if (c && strchr(symbols, c)) usage = 0x2C + (strchr(symbols, c) - symbols);
+    else if (c && strchr(symbolsShifted, c)) { usage = 0x2C + (strchr(symbolsShifted, c) - symbolsShifted); shift = true; }
+    else return false;
+    return true;
+}
+
+size_t NKROKeyboard_::add(KeyboardKeycode k) {
+    keys[k >> 3] |= 1 << (k & 7);
+    return 1;
+}
+
+size_t NKROKeyboard_::remove(KeyboardKeycode k) {
+    keys[k >> 3] &= ~(1 << (k & 7));
+    return 1;
+}
+
+size_t NKROKeyboard_::add(uint8_t k) {
+    uint8_t usage;
+    bool shift;
+    if (k >= 128 || !asciiToUsage(k, usage, shift)) return 0;
+    if (shift) add(KEY_LEFT_SHIFT);
+    return add((KeyboardKeycode)usage);
+}
+
+size_t NKROKeyboard_::remove(uint8_t k) {
+    uint8_t usage;
+    bool shift;
+    if (k >= 128 || !asciiToUsage(k, usage, shift)) return 0;
+    if (shift) remove(KEY_LEFT_SHIFT);
+    return remove((KeyboardKeycode)usage);
+}
+
+int NKROKeyboard_::send() {
+    if (usbBusy) return -1;
+    hal::Report r = blankReport;
+    r.micros = micros();
+    r.device = hal::DEVICE_KEYBOARD;
+    memcpy(r.keys, keys, sizeof(keys));
+    reportLog.push_back(r);
+    return sizeof(keys);
+}
+
+void Mouse_::buttons(uint8_t b) {
+    if (b == buttonState) return;
+    buttonState = b;
+    // The real library drops the report when the endpoint is busy
+    if (usbBusy) return;
+    hal::Report r = blankReport;
+    r.micros = micros();
+    r.device = hal::DEVICE_MOUSE;
+    r.buttons = b;
+    reportLog.push_back(r);
+}
+
+// NeoPixel
+Adafruit_NeoPixel::Adafruit_NeoPixel(uint16_t n, int16_t pin, neoPixelType t) {
+    (void)pin;
+    wOffset = (t >> 6) & 3;
+    rOffset = (t >> 4) & 3;
+    gOffset = (t >> 2) & 3;
+    bOffset = t & 3;
+    numLEDs = n;
+    numBytes = n * ((wOffset == rOffset) ? 3 : 4);
+    pixels = (uint8_t *)calloc(numBytes, 1);
+}
+
+Adafruit_NeoPixel::~Adafruit_NeoPixel() { free(pixels); }
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) {
+    if (n >= numLEDs) return;
+    uint8_t *p = &pixels[n * ((wOffset == rOffset) ? 3 : 4)];
+    if (wOffset != rOffset) p[wOffset] = 0;
+    p[rOffset] = r;
+    p[gOffset] = g;
+    p[bOffset] = b;
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
+    setPixelColor(n, r, g, b);
+    if (n < numLEDs && wOffset != rOffset) pixels[n * 4 + wOffset] = w;
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint32_t c) {
+    setPixelColor(n, c >> 16, c >> 8, c, c >> 24);
+}
+
+uint32_t Adafruit_NeoPixel::getPixelColor(uint16_t n) const {
+    if (n >= numLEDs) return 0;
+    const uint8_t *p = &pixels[n * ((wOffset == rOffset) ? 3 : 4)];
+    uint32_t c = ((uint32_t)p[rOffset] << 16) | ((uint32_t)p[gOffset] << 8) | p[bOffset];
+    if (wOffset != rOffset) c |= (uint32_t)p[wOffset] << 24;
+    return c;
+}
+
+uint32_t Adafruit_NeoPixel::ColorHSV(uint16_t hue, uint8_t sat, uint8_t val) {
+    uint8_t r, g, b;
+    hue = (hue * 1530L + 32768) / 65536;
+    if (hue < 510) {
+        b = 0;
+        if (hue < 255) { r = 255; g = hue; }
+        else { r = 510 - hue; g = 255; }
+    } else if (hue < 1020) {
+        r = 0;
+        if (hue < 765) { g = 255; b = hue - 510; }
+        else { g = 1020 - hue; b = 255; }
+    } else if (hue < 1530) {
+        g = 0;
+        if (hue < 1275) { r = hue - 1020; b = 255; }
+        else { r = 255; b = 1530 - hue; }
+    } else {
+        r = 255;
+        g = b = 0;
+    }
+    uint32_t v1 = 1 + val;
+    uint16_t s1 = 1 + sat;
+    uint8_t s2 = 255 - sat;
+    return ((((((r * s1) >> 8) + s2) * v1) & 0xff00) << 8) |
+           (((((g * s1) >> 8) + s2) * v1) & 0xff00) |
+           (((((b * s1) >> 8) + s2) * v1) >> 8);
+}
+
+void Adafruit_NeoPixel::show() {
+    // Wait out the 300us latch, then 1.25us per bit with interrupts off
+    uint64_t latch = lastShowEnd + 300 * cyclesPerMicro;
+    if (clockCycles < latch) run(latch - clockCycles);
+    run((uint64_t)numBytes * 10 * cyclesPerMicro, true);
+    lastShowEnd = clockCycles;
+    wire.assign(pixels, pixels + numBytes);
+    frames++;
+}
+
+int pinPeripheral(uint32_t pin, EPioType) {
+    if (pin >= numPins) return -1;
+    hal_port.Group[g_APinDescription[pin].ulPort].PINCFG[g_APinDescription[pin].ulPin].bit.PMUXEN = 1;
+    return 0;
+}
+
+// PTC, one conversion at a time
+void adafruit_ptc_get_config_default(struct adafruit_ptc_config *config) {
+    memset(config, 0, sizeof(*config));
+    config->yline = -1;
+    config->oversample = OVERSAMPLE_4;
+    config->compcap = 0x2000;
+    config->intcap = 0x3f;
+}
+
+void adafruit_ptc_init(Ptc *, struct adafruit_ptc_config const *) {}
+
+void adafruit_ptc_start_conversion(Ptc *, struct adafruit_ptc_config const *config) {
+    ptcDone = clockCycles + (uint64_t)(40u << config->oversample) * cyclesPerMicro;
+    ptcResult = config->pin < numPins ? touchRaw[config->pin] << config->oversample : 0;
+}
+
+bool adafruit_ptc_is_conversion_finished(Ptc *) { return clockCycles >= ptcDone; }
+
+uint16_t adafruit_ptc_get_conversion_result(Ptc *) { return ptcResult; }
+
+// FreeTouch
+uint16_t Adafruit_FreeTouch::measure() {
+    adafruit_ptc_config config;
+    adafruit_ptc_get_config_default(&config);
+    config.pin = pin;
+    config.oversample = oversample;
+    config.seriesres = seriesres;
+    config.freqhop = freqhop;
+    adafruit_ptc_start_conversion(PTC, &config);
+    if (clockCycles < ptcDone) run(ptcDone - clockCycles);
+    return adafruit_ptc_get_conversion_result(PTC) >> oversample;
+}
+
+// Flash
+FlashClass::FlashClass(const void *flash_addr, uint32_t size)
+    : flash_address(flash_addr), flash_size(size), memory((uint8_t *)malloc(size)), nextFlash(flashList) {
+    memset(memory, 0xff, size);
+    flashList = this;
+}
+
+FlashClass::~FlashClass() { free(memory); }
+
+uint8_t *FlashClass::at(const volatile void *flash_ptr, uint32_t size) {
+    uintptr_t offset = (uintptr_t)flash_ptr - (uintptr_t)flash_address;
+    if (offset + size > flash_size) abort();
+    return memory + offset;
+}
+
+void FlashClass::write(const volatile void *flash_ptr, const void *data, uint32_t size) {
+    // Whole words, a page at a time
+    size = (size + 3) & ~3u;
+    uint8_t *dst = at(flash_ptr, size);
+    for (uint32_t x = 0; x < size; x++) dst[x] &= ((const uint8_t *)data)[x];
+    flashPages += (size + 63) / 64;
+}
+
+void FlashClass::erase(const volatile void *flash_ptr, uint32_t size) {
+    size = (size + FLASH_ROW_SIZE - 1) / FLASH_ROW_SIZE * FLASH_ROW_SIZE;
+    memset(at(flash_ptr, size), 0xff, size);
+    erases += size / FLASH_ROW_SIZE;
+}
+
+void FlashClass::read(const volatile void *flash_ptr, void *data, uint32_t size) {
+    memcpy(data, at(flash_ptr, size), size);
+}
+
+void halFlashReset() {
+    for (FlashClass *f = flashList; f; f = f->nextFlash) memset(f->memory, 0xff, f->flash_size);
+}
+
+// EEPROM
+void halEepromReset() {
+    memset(EEPROM.buffer, 0xff, sizeof(EEPROM.buffer));
+    EEPROM.valid = false;
+    EEPROM.dirty = false;
+}
+
+void EEPROMClass::commit() {
+    if (!dirty) return;
+    valid = true;
+    dirty = false;
+    erases += EEPROM_EMULATION_SIZE / 256;
+}
+
+namespace hal {
+
+void reset() {
+    clockCycles = 0;
+    memset(&hal_gclk, 0, sizeof(hal_gclk));
+    memset(&hal_tc3, 0, sizeof(hal_tc3));
+    tc3Irq = irqMasked = inHandler = tickPending = false;
+    nextTick = 0;
+    lastShowEnd = 0;
+    wire.clear();
+    dmaDone = 0;
+    memset(&hal_pm, 0, sizeof(hal_pm));
+    memset(hal_sercom, 0, sizeof(hal_sercom));
+    memset(&hal_dmac, 0, sizeof(hal_dmac));
+    memset(&hal_usb, 0, sizeof(hal_usb));
+    usbSuspended = false;
+    memset(pinIsr, 0, sizeof(pinIsr));
+    ptcDone = 0;
+    ptcResult = 0;
+    memset(&hal_port, 0, sizeof(hal_port));
+    // Everything floats high as if pulled up
+    hal_port.Group[0].IN.reg = hal_port.Group[1].IN.reg = 0xffffffff;
+    pinLevel[0] = pinLevel[1] = 0xffffffff;
+    switches.clear();
+    for (uint8_t x = 0; x < numPins; x++) touchRaw[x] = 700;
+    serialIn.clear();
+    serialOut.clear();
+    serialWritable = serialSpace = 63;
+    serialFrame = 0;
+    serialOpen = true;
+    serialTimedOut = false;
+    usbBusy = false;
+    reportLog.clear();
+    frames = 0;
+    erases = 0;
+    flashPages = 0;
+    halEepromReset();
+    halFlashReset();
+}
+
+uint64_t now() { return clockCycles / cyclesPerMicro; }
+void advance(uint32_t us) { run((uint64_t)us * cyclesPerMicro); }
+
+void setPin(uint8_t pin, bool level) {
+    if (pin >= numPins) return;
+    PortGroup &g = hal_port.Group[g_APinDescription[pin].ulPort];
+    uint32_t mask = 1ul << g_APinDescription[pin].ulPin;
+    bool was = g.IN.reg & mask;
+    if (level) pinLevel[g_APinDescription[pin].ulPort] |= mask;
+    else pinLevel[g_APinDescription[pin].ulPort] &= ~mask;
+    if (level) g.IN.reg |= mask;
+    else g.IN.reg &= ~mask;
+    if (!pinIsr[pin] || was == level || irqMasked) return;
+    uint8_t mode = pinIsrMode[pin];
+    if (mode == CHANGE || (mode == FALLING && !level) || (mode == RISING && level)) pinIsr[pin]();
+}
+
+void setSwitch(uint8_t a, uint8_t b, bool closed) {
+    for (size_t x = 0; x < switches.size(); x++) {
+        if (switches[x] == std::make_pair(a, b)) switches.erase(switches.begin() + x--);
+    }
+    if (closed) switches.push_back(std::make_pair(a, b));
+}
+
+bool getPin(uint8_t pin) { return digitalRead(pin); }
+
+void setTouch(uint8_t pin, uint16_t raw) { if (pin < numPins) touchRaw[pin] = raw; }
+
+void serialInput(const char *s) { while (*s) serialIn.push_back(*s++); }
+
+std::string serialOutput() {
+    std::string s;
+    s.swap(serialOut);
+    return s;
+}
+
+void setSerialWritable(int bytes) { serialWritable = bytes; }
+void setSerialOpen(bool open) { serialOpen = open; }
+
+void setUsbBusy(bool busy) { usbBusy = busy; }
+void setUsbSuspended(bool suspended) { usbSuspended = suspended; }
+const std::vector<Report> &reports() { return reportLog; }
+void clearReports() { reportLog.clear(); }
+
+uint32_t ledFrames() { return frames; }
+const std::vector<uint8_t> &ledWire() { return wire; }
+uint32_t flashErases() { return erases; }
+uint32_t flashPageWrites() { return flashPages; }
+
+}
@@ -0,0 +1,56 @@
+// Harness side of the native shim.
+// Benchmarks and tests drive pins, touch pads, serial input and the clock
+// from here and read back the HID reports the firmware produced.
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace hal {
+
+enum { DEVICE_KEYBOARD, DEVICE_MOUSE };
+
+// One report as the host would receive it
+struct Report {
+    uint32_t micros;
+    uint8_t device;
+    uint8_t keys[32]; // NKRO bitmap indexed by HID usage
+    uint8_t buttons;
+    bool key(uint8_t usage) const { return keys[usage >> 3] & (1 << (usage & 7)); }
+};
+
+// Put every peripheral back to power-on state and the clock at zero
+void reset();
+
+uint64_t now();
+void advance(uint32_t us);
+
+void setPin(uint8_t pin, bool level);
+// Close or open a key matrix switch between two pins
+void setSwitch(uint8_t a, uint8_t b, bool closed);
+bool getPin(uint8_t pin);
+void setTouch(uint8_t pin, uint16_t raw);
+
+void serialInput(const char *s);
+std::string serialOutput();
+// Bytes the host reads per 1ms USB frame, 0 for a terminal that's open
+// but not reading
+void setSerialWritable(int bytes);
+// Terminal open (DTR set)
+void setSerialOpen(bool open);
+
+void setUsbBusy(bool busy);
+// Host stops sending frames, as when it sleeps
+void setUsbSuspended(bool suspended);
+const std::vector<Report> &reports();
+void clearReports();
+
+// Frames latched by the strip, and the bytes of the last one in wire order
+uint32_t ledFrames();
+const std::vector<uint8_t> &ledWire();
+// Flash rows erased and pages written, by EEPROM emulation and FlashClass
+uint32_t flashErases();
+uint32_t flashPageWrites();
+
+}
@@ -0,0 +1,181 @@
+// SAMD21 peripheral registers for host builds.
+// Just the registers and fields the firmware touches. The timer and the DMA
+// channel are emulated by hal_native.cpp on the virtual clock.
+#pragma once
+
+#include <stdint.h>
+
+#define F_CPU 48000000ul
+
+// PORT
+typedef enum { NOT_A_PORT = -1, PORTA = 0, PORTB = 1 } EPortType;
+typedef struct {
+    EPortType ulPort;
+    uint32_t ulPin;
+} PinDescription;
+extern const PinDescription g_APinDescription[];
+
+typedef union {
+    struct {
+        uint8_t PMUXEN:1;
+        uint8_t INEN:1;
+        uint8_t PULLEN:1;
+        uint8_t :3;
+        uint8_t DRVSTR:1;
+        uint8_t :1;
+    } bit;
+    uint8_t reg;
+} PORT_PINCFG_Type;
+
+typedef union {
+    uint32_t reg;
+} PORT_REG_Type;
+
+typedef struct {
+    PORT_REG_Type DIR;
+    PORT_REG_Type OUT;
+    PORT_REG_Type IN;
+    PORT_PINCFG_Type PINCFG[32];
+} PortGroup;
+
+typedef struct {
+    PortGroup Group[2];
+} Port;
+
+extern Port hal_port;
+#define PORT (&hal_port)
+
+// GCLK
+typedef struct {
+    union { uint16_t reg; } CLKCTRL;
+    union {
+        struct { uint8_t :7; uint8_t SYNCBUSY:1; } bit;
+        uint8_t reg;
+    } STATUS;
+} Gclk;
+extern Gclk hal_gclk;
+#define GCLK (&hal_gclk)
+#define GCLK_CLKCTRL_CLKEN (1 << 14)
+#define GCLK_CLKCTRL_GEN_GCLK0 (0 << 8)
+#define GCLK_CLKCTRL_ID(id) (id)
+#define GCLK_CLKCTRL_ID_TCC2_TC3 0x1B
+
+// PM
+typedef struct {
+    union { uint32_t reg; } AHBMASK;
+    union { uint32_t reg; } APBBMASK;
+    union { uint32_t reg; } APBCMASK;
+} Pm;
+extern Pm hal_pm;
+#define PM (&hal_pm)
+#define PM_AHBMASK_DMAC (1 << 5)
+#define PM_APBBMASK_DMAC (1 << 4)
+#define PM_APBCMASK_SERCOM0 (1 << 2)
+#define PM_APBCMASK_SERCOM3 (1 << 5)
+
+// SERCOM, SPI mode only
+typedef struct {
+    union { uint32_t reg; } CTRLA;
+    union { uint32_t reg; } CTRLB;
+    union { uint8_t reg; } BAUD;
+    union {
+        struct { uint32_t SWRST:1; uint32_t ENABLE:1; uint32_t CTRLB:1; uint32_t :29; } bit;
+        uint32_t reg;
+    } SYNCBUSY;
+    union { uint32_t reg; } DATA;
+} SercomSpi;
+typedef union {
+    SercomSpi SPI;
+} Sercom;
+extern Sercom hal_sercom[6];
+#define SERCOM0 (&hal_sercom[0])
+#define SERCOM3 (&hal_sercom[3])
+#define SERCOM0_GCLK_ID_CORE 20
+#define SERCOM3_GCLK_ID_CORE 23
+#define SERCOM0_DMAC_ID_TX 2
+#define SERCOM3_DMAC_ID_TX 8
+#define SERCOM_SPI_CTRLA_SWRST (1 << 0)
+#define SERCOM_SPI_CTRLA_ENABLE (1 << 1)
+#define SERCOM_SPI_CTRLA_MODE_SPI_MASTER (3 << 2)
+#define SERCOM_SPI_CTRLA_DOPO(x) ((x) << 16)
+
+// DMAC, one channel. Addresses are pointer sized on the host.
+typedef struct {
+    union { uint16_t reg; } BTCTRL;
+    union { uint16_t reg; } BTCNT;
+    union { uintptr_t reg; } SRCADDR;
+    union { uintptr_t reg; } DSTADDR;
+    union { uintptr_t reg; } DESCADDR;
+} DmacDescriptor;
+typedef struct {
+    union { uint16_t reg; } CTRL;
+    union { uintptr_t reg; } BASEADDR;
+    union { uintptr_t reg; } WRBADDR;
+    union { uint8_t reg; } CHID;
+    union { uint8_t reg; } CHCTRLA;
+    union { uint32_t reg; } CHCTRLB;
+} Dmac;
+extern Dmac hal_dmac;
+#define DMAC (&hal_dmac)
+#define DMAC_CTRL_DMAENABLE (1 << 1)
+#define DMAC_CTRL_LVLEN(x) ((x) << 8)
+#define DMAC_CHID_ID(x) (x)
+#define DMAC_CHCTRLA_SWRST (1 << 0)
+#define DMAC_CHCTRLA_ENABLE (1 << 1)
+#define DMAC_CHCTRLB_TRIGSRC(x) ((x) << 8)
+#define DMAC_CHCTRLB_TRIGACT_BEAT (2 << 22)
+#define DMAC_BTCTRL_VALID (1 << 0)
+#define DMAC_BTCTRL_BEATSIZE_BYTE (0 << 8)
+#define DMAC_BTCTRL_SRCINC (1 << 10)
+
+// TC, 16-bit counter mode only
+typedef struct {
+    union { uint16_t reg; } CTRLA;
+    union { uint8_t reg; } INTENCLR;
+    union { uint8_t reg; } INTENSET;
+    union { uint8_t reg; } INTFLAG;
+    union {
+        struct { uint8_t :7; uint8_t SYNCBUSY:1; } bit;
+        uint8_t reg;
+    } STATUS;
+    union { uint16_t reg; } COUNT;
+    union { uint16_t reg; } CC[2];
+} TcCount16;
+typedef union {
+    TcCount16 COUNT16;
+} Tc;
+extern Tc hal_tc3;
+#define TC3 (&hal_tc3)
+#define TC_CTRLA_ENABLE (1 << 1)
+#define TC_CTRLA_MODE_COUNT16 (0 << 2)
+#define TC_CTRLA_WAVEGEN_MFRQ (1 << 5)
+#define TC_CTRLA_PRESCALER_DIV1 (0 << 8)
+#define TC_INTENSET_MC0 (1 << 4)
+#define TC_INTENCLR_MC0 (1 << 4)
+#define TC_INTFLAG_MC0 (1 << 4)
+
+// USB device, just the frame counter. It stops while the bus is suspended.
+typedef struct {
+    union {
+        struct { uint16_t MFNUM:3; uint16_t FNUM:11; uint16_t :1; uint16_t FNCERR:1; } bit;
+        uint16_t reg;
+    } FNUM;
+} UsbDevice;
+typedef union {
+    UsbDevice DEVICE;
+} Usb;
+extern Usb hal_usb;
+#define USB (&hal_usb)
+
+// NVIC
+typedef enum { TC3_IRQn = 18 } IRQn_Type;
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+void NVIC_SetPendingIRQ(IRQn_Type irq);
+void __disable_irq();
+void __enable_irq();
+// Sleeps until the next timer tick or SysTick (1ms)
+void __WFI();
+
+extern "C" void TC3_Handler(void) __attribute__((weak));
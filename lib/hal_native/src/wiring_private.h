@@ -0,0 +1,11 @@
+// Host version of the core's pin muxing helper.
+#pragma once
+
+#include <Arduino.h>
+
+typedef enum {
+    PIO_SERCOM = 2,
+    PIO_SERCOM_ALT = 3,
+} EPioType;
+
+int pinPeripheral(uint32_t pin, EPioType type);
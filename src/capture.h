@@ -0,0 +1,72 @@
+// Raw touch capture
+// Records every PTC result at full scan rate into a RAM ring so thresholds
+// can be tuned offline (tools/touchreplay.cpp replays a capture through
+// touch.h). Each sweep is stored as one record: the time since the last
+// sweep started (us, saturating) followed by the raw value of each pad.
+//
+// captureWrite() sends the oldest record first as little-endian 16 bit
+// words, which is just the ring's memory on the SAMD21.
+//
+// The ring is 2 KB, about 200 sweeps or a third of a second on a
+// MegaTouch. Build with -DCAPTURE_WORDS=4096 or more for longer captures.
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef CAPTURE_WORDS
+#define CAPTURE_WORDS 1024
+#endif
+static_assert(CAPTURE_WORDS < 0x10000, "capture positions are 16 bit");
+#define CAPTURE_MAX_PADS 16
+
+struct TouchCapture {
+    bool enabled;
+    bool sweeping;    // Waiting for pad 0 so records start on a sweep
+    uint16_t head;    // Word the next record starts at
+    uint16_t records; // Complete records in the ring
+    unsigned long last;
+    uint8_t baseline[CAPTURE_MAX_PADS]; // Baselines when capture started
+    uint16_t ring[CAPTURE_WORDS];
+};
+
+inline uint16_t captureCapacity(uint8_t pads) { return CAPTURE_WORDS / (pads + 1); }
+
+inline void captureEnable(TouchCapture &c, bool on) {
+    __disable_irq();
+    if (on) {
+        c.head = 0;
+        c.records = 0;
+        c.sweeping = false;
+    }
+    c.enabled = on;
+    __enable_irq();
+}
+
+// Call with every result as it comes in
+inline void captureSample(TouchCapture &c, uint8_t pads, uint8_t pad, uint16_t value, unsigned long now) {
+    if (pad == 0) {
+        unsigned long gap = c.sweeping ? now - c.last : 0;
+        c.ring[c.head] = gap > 0xffff ? 0xffff : gap;
+        c.last = now;
+        c.sweeping = true;
+    }
+    if (!c.sweeping) return;
+    c.ring[c.head + 1 + pad] = value;
+    if (pad == pads - 1) {
+        uint16_t capacity = captureCapacity(pads);
+        c.head += pads + 1;
+        if (c.head >= capacity * (pads + 1)) c.head = 0;
+        if (c.records < capacity) c.records++;
+    }
+}
+
+// Send the records, oldest first; capture has to be stopped
+inline void captureWrite(const TouchCapture &c, uint8_t pads, Print &out) {
+    uint16_t end = captureCapacity(pads) * (pads + 1);
+    uint16_t start = c.records * (pads + 1) < end ? 0 : c.head;
+    uint16_t words = c.records * (pads + 1);
+    // Up to the end of the ring, then from the start
+    uint16_t first = end - start < words ? end - start : words;
+    out.write((const uint8_t *)&c.ring[start], first * 2);
+    out.write((const uint8_t *)c.ring, (words - first) * 2);
+}
@@ -0,0 +1,72 @@
+// Buffered console output
+// Printing straight to Serial can stall for as long as the host takes to
+// read, or until the USB stack times out when nothing is listening. Output
+// goes into a ring buffer instead and drain() passes on one endpoint packet
+// a loop, only while a terminal has the port open (DTR). If the buffer
+// fills, new output is dropped and counted.
+//
+// The SAMD core's availableForWrite() is always a packet, so it can't tell
+// a host that isn't reading. Its send then blocks for the USB timeout once
+// and returns 0 from then on, and drain() drops what's left rather than
+// trying again every loop.
+//
+// The menus wait on the user anyway, so they set sync and print directly.
+#pragma once
+
+#include <Arduino.h>
+
+#define CONSOLE_SIZE 512 // Power of two
+
+class Console : public Print {
+public:
+    bool sync;        // Wait for the host instead of buffering
+    uint32_t dropped; // Bytes lost to a full buffer
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+
+    size_t write(const uint8_t *buf, size_t size) override {
+        if (sync) {
+            flush();
+            return Serial.write(buf, size);
+        }
+        for (size_t x=0; x<size; x++) {
+            if (head - tail == CONSOLE_SIZE) { dropped += size - x; break; }
+            ring[head++ & (CONSOLE_SIZE - 1)] = buf[x];
+        }
+        return size;
+    }
+
+    // Send up to one packet. dtr() rather than Serial's bool, which delays
+    // 10ms on the SAMD core.
+    void drain() {
+        if (head == tail || !Serial.dtr()) return;
+        int space = Serial.availableForWrite();
+        if (space <= 0) return;
+        uint16_t start = tail & (CONSOLE_SIZE - 1);
+        uint16_t n = head - tail;
+        if (n > CONSOLE_SIZE - start) n = CONSOLE_SIZE - start; // Up to the wrap
+        if (n > (uint16_t)space) n = space;
+        size_t sent = Serial.write(&ring[start], n);
+        // Nobody's reading, give up on the rest
+        if (!sent) { dropped += head - tail; tail = head; return; }
+        tail += sent;
+    }
+
+    // Send everything, waiting on the host
+    void flush() {
+        while (head != tail) {
+            uint16_t start = tail & (CONSOLE_SIZE - 1);
+            uint16_t n = head - tail;
+            if (n > CONSOLE_SIZE - start) n = CONSOLE_SIZE - start;
+            size_t sent = Serial.write(&ring[start], n);
+            // Nobody's listening, give up on the rest
+            if (!sent) { dropped += head - tail; tail = head; return; }
+            tail += sent;
+        }
+    }
+
+private:
+    uint8_t ring[CONSOLE_SIZE];
+    uint16_t head; // Free-running, masked on access
+    uint16_t tail;
+};
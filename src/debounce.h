@@ -0,0 +1,56 @@
+// Debounce engine for direct-pin and matrix models
+// Every mode is a pair of windows for each key: a key has to hold its new
+// level for its press window before a press is reported, and for its
+// release window before a release is. Eager mode has no press window, so a
+// press goes out on the first scan that sees it while bounce on release is
+// still filtered.
+//
+// Key state is kept as bitmasks (bit x is key x, set when held), and only
+// keys that changed or haven't settled yet are looked at, so a scan with
+// nothing going on costs the same for any number of keys.
+#pragma once
+
+#include <Arduino.h>
+
+#define DEBOUNCE_STABLE 0     // Same window both ways (the old Bounce2 behaviour)
+#define DEBOUNCE_EAGER 1      // Press immediately, release after the window
+#define DEBOUNCE_ASYMMETRIC 2 // Separate press and release windows
+#define DEBOUNCE_MODES 3
+
+#define DEBOUNCE_MAX_KEYS 32
+
+struct Debouncer {
+    uint32_t raw;                             // Keys read as held
+    uint32_t state;                           // Debounced keys held
+    unsigned long changed[DEBOUNCE_MAX_KEYS]; // When each raw bit last changed (us)
+};
+
+// Press window in ms for a mode; the release window is always the interval
+inline uint8_t pressWindow(uint8_t mode, uint8_t interval, uint8_t asymPress) {
+    switch (mode) {
+        case DEBOUNCE_EAGER: return 0;
+        case DEBOUNCE_ASYMMETRIC: return asymPress;
+        default: return interval;
+    }
+}
+
+// Feed one scan of raw key bits, returns the debounced bits. The windows
+// are in ms, one per key.
+inline uint32_t debounce(Debouncer &d, uint32_t raw, unsigned long now, const uint8_t *pressMs, const uint8_t *releaseMs) {
+    uint32_t changed = raw ^ d.raw;
+    d.raw = raw;
+    while (changed) {
+        d.changed[__builtin_ctz(changed)] = now;
+        changed &= changed - 1;
+    }
+    // Keys whose raw level doesn't match the debounced one yet
+    uint32_t unsettled = raw ^ d.state;
+    while (unsettled) {
+        uint8_t x = __builtin_ctz(unsettled);
+        uint32_t bit = 1ul << x;
+        unsigned long window = ((raw & bit) ? pressMs[x] : releaseMs[x]) * 1000ul;
+        if (now - d.changed[x] >= window) d.state ^= bit;
+        unsettled &= unsettled - 1;
+    }
+    return d.state;
+}
@@ -0,0 +1,99 @@
+// Keycode dispatch
+// mapping[] holds configurator codes: plain ASCII below 128, then the
+// special keys in friendlyKeys[] order from 128, with mouse buttons at the
+// end and macros from 200 (see macro.h). compileKey() turns a code into a
+// report type and HID usage once, so pressing a key is a table lookup and a
+// single call.
+//
+// Handlers only edit the pending reports; flushReports() sends them, so all
+// edges from one scan reach the host together.
+#pragma once
+
+#include <HID-Project.h>
+
+// Report types
+#define ACTION_NONE 0
+#define ACTION_ASCII 1
+#define ACTION_KEY 2
+#define ACTION_MOUSE 3
+#define ACTION_MACRO 4
+
+struct KeyAction {
+    uint8_t type;
+    uint8_t usage;
+};
+
+// Codes 128-194, in friendlyKeys[] order (do not re-arrange)
+const KeyboardKeycode specialKeys[] = {
+    KEY_LEFT_CTRL, KEY_LEFT_SHIFT, KEY_LEFT_ALT, KEY_LEFT_GUI, KEY_RIGHT_CTRL,
+    KEY_RIGHT_SHIFT, KEY_RIGHT_ALT, KEY_RIGHT_GUI, KEY_ESC, KEY_F1, KEY_F2,
+    KEY_F3, KEY_F4, KEY_F5, KEY_F6, KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11,
+    KEY_F12, KEY_F13, KEY_F14, KEY_F15, KEY_F16, KEY_F17, KEY_F18, KEY_F19,
+    KEY_F20, KEY_F21, KEY_F22, KEY_F23, KEY_F24, KEY_ENTER, KEY_BACKSPACE,
+    KEY_TAB, KEY_PRINT, KEY_PAUSE, KEY_INSERT, KEY_HOME, KEY_PAGE_UP,
+    KEY_DELETE, KEY_END, KEY_PAGE_DOWN, KEY_RIGHT, KEY_LEFT, KEY_DOWN, KEY_UP,
+    KEYPAD_DIVIDE, KEYPAD_MULTIPLY, KEYPAD_SUBTRACT, KEYPAD_ADD, KEYPAD_ENTER,
+    KEYPAD_1, KEYPAD_2, KEYPAD_3, KEYPAD_4, KEYPAD_5, KEYPAD_6, KEYPAD_7,
+    KEYPAD_8, KEYPAD_9, KEYPAD_0, KEY_MENU, KEY_VOLUME_MUTE, KEY_VOLUME_UP,
+    KEY_VOLUME_DOWN
+};
+const uint8_t firstSpecial = 128;
+const uint8_t firstMouse = firstSpecial + sizeof(specialKeys);
+
+// Codes 195-199
+const uint8_t mouseButtons[] = { MOUSE_LEFT, MOUSE_RIGHT, MOUSE_MIDDLE, MOUSE_PREV, MOUSE_NEXT };
+const uint8_t lastMouse = firstMouse + sizeof(mouseButtons) - 1;
+
+// Codes 200 and up
+const uint8_t firstMacro = 200;
+
+inline KeyAction compileKey(uint8_t code) {
+    KeyAction action;
+    if (code < firstSpecial) { action.type = ACTION_ASCII; action.usage = code; }
+    else if (code < firstMouse) { action.type = ACTION_KEY; action.usage = specialKeys[code - firstSpecial]; }
+    else if (code <= lastMouse) { action.type = ACTION_MOUSE; action.usage = mouseButtons[code - firstMouse]; }
+    else if (code >= firstMacro) { action.type = ACTION_MACRO; action.usage = code; }
+    else { action.type = ACTION_NONE; action.usage = 0; }
+    return action;
+}
+
+// Report assembly state
+static bool keyboardPending;
+static uint8_t mousePressed;
+static uint8_t mouseReleased;
+// Mapping code of a macro to start, picked up by macroStep()
+static uint8_t macroQueued;
+
+typedef void (*KeyHandler)(uint8_t usage);
+static void noKey(uint8_t) {}
+// Characters without a key in the layout don't change the report
+static void asciiPress(uint8_t usage) { if (NKROKeyboard.add(usage)) keyboardPending = true; }
+static void asciiRelease(uint8_t usage) { if (NKROKeyboard.remove(usage)) keyboardPending = true; }
+static void keyPress(uint8_t usage) { NKROKeyboard.add((KeyboardKeycode)usage); keyboardPending = true; }
+static void keyRelease(uint8_t usage) { NKROKeyboard.remove((KeyboardKeycode)usage); keyboardPending = true; }
+static void mousePress(uint8_t usage) { mousePressed |= usage; }
+static void mouseRelease(uint8_t usage) { mouseReleased |= usage; }
+// A macro plays out on its own once started, so releases do nothing. One
+// more can wait to start while one is playing.
+static void macroPress(uint8_t usage) { if (!macroQueued) macroQueued = usage; }
+
+// Indexed by [pressed][type]
+const KeyHandler keyHandlers[2][5] = {
+    { noKey, asciiRelease, keyRelease, mouseRelease, noKey },
+    { noKey, asciiPress, keyPress, mousePress, macroPress },
+};
+
+inline void dispatchKey(const KeyAction &action, bool press) {
+    keyHandlers[press][action.type](action.usage);
+}
+
+// Send whatever the handlers queued up. Returns false while the keyboard
+// endpoint is still refusing the last report; it stays queued for the next
+// call. Mouse reports can't be refused (the library drops them itself), so
+// they go out as at most one release and one press.
+static inline bool flushReports() {
+    if (keyboardPending && NKROKeyboard.send() > 0) keyboardPending = false;
+    if (mouseReleased) { Mouse.release(mouseReleased); mouseReleased = 0; }
+    if (mousePressed) { Mouse.press(mousePressed); mousePressed = 0; }
+    return !keyboardPending;
+}
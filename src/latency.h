@@ -0,0 +1,53 @@
+// Input latency measurement
+// Times every key from its raw edge (the first pin transition, bounce
+// included, or the touch sample that crossed the threshold) to the moment
+// its report is handed to the USB stack. That covers debounce, touch
+// sampling, scan jitter and whatever loop() was busy with. Results go into
+// a profile histogram per key and direction (see profile.h).
+//
+// An edge that goes back to the reported level without being reported is
+// noise and is dropped with latencyCancel().
+#pragma once
+
+#include <Arduino.h>
+#include <profile.h>
+
+#define LATENCY_MAX_KEYS 32
+
+struct LatencyTracker {
+    bool enabled;
+    uint32_t pending; // Keys with an edge that hasn't been reported
+    uint32_t queued;  // Keys in a report waiting on the endpoint
+    unsigned long edge[LATENCY_MAX_KEYS]; // When each pending edge happened (us)
+};
+
+// Stamp raw edges, keeping the first one while a key bounces
+inline void latencyEdge(LatencyTracker &l, uint32_t keys, unsigned long now) {
+    keys &= ~l.pending;
+    l.pending |= keys;
+    while (keys) {
+        l.edge[__builtin_ctz(keys)] = now;
+        keys &= keys - 1;
+    }
+}
+
+inline void latencyCancel(LatencyTracker &l, uint32_t keys) {
+    l.pending &= ~(keys & ~l.queued);
+}
+
+// Keys that went into the report being built
+inline void latencyQueue(LatencyTracker &l, uint32_t keys) {
+    l.queued |= keys & l.pending;
+}
+
+// The queued report went out; down says which keys were pressed
+inline void latencySent(LatencyTracker &l, unsigned long now, uint32_t down, ProfileStage *press, ProfileStage *release) {
+    uint32_t keys = l.queued;
+    while (keys) {
+        uint8_t x = __builtin_ctz(keys);
+        profileRecord(((down >> x) & 1) ? press[x] : release[x], now - l.edge[x]);
+        keys &= keys - 1;
+    }
+    l.pending &= ~l.queued;
+    l.queued = 0;
+}
@@ -0,0 +1,85 @@
+// Macros
+// Mapping codes from firstMacro (200) play a macro instead of a key. Macros are
+// kept back to back in one small table, each ending with MACRO_END, and
+// are made of the same codes as mapping[] plus a few of their own:
+//
+//   MACRO_CTRL/SHIFT/ALT/GUI hold a modifier for the next key, like ^ + ! #
+//   in AutoHotkey, so ctrl+alt+delete is MACRO_CTRL, MACRO_ALT, 169.
+//   MACRO_WAIT n pauses for n * 10 ms.
+//
+// macroStep() runs from keyboard() and does at most one thing per call (a
+// press or a release, one report each), so a macro plays out while keys
+// keep being scanned and reported, without any waiting or allocation.
+#pragma once
+
+#include <Arduino.h>
+#include <keycodes.h>
+
+#define MACRO_BYTES 64
+
+#define MACRO_END 0
+#define MACRO_CTRL 200
+#define MACRO_SHIFT 201
+#define MACRO_ALT 202
+#define MACRO_GUI 203
+#define MACRO_WAIT 204
+
+struct MacroPlayer {
+    uint8_t at;      // Next byte in the table
+    bool playing;
+    bool held;       // The last key (and its modifiers) is still down
+    uint8_t key;
+    uint8_t mods;    // Bit n is MACRO_CTRL + n
+    unsigned long waitStart;
+    uint16_t wait;   // ms
+};
+
+// Start of macro n, or MACRO_BYTES if the table doesn't have that many
+inline uint8_t macroFind(const uint8_t *table, uint8_t n) {
+    uint8_t at = 0;
+    while (n && at < MACRO_BYTES) if (table[at++] == MACRO_END) n--;
+    return at;
+}
+
+inline void macroKeys(const MacroPlayer &p, bool press) {
+    for (uint8_t x=0; x<4; x++) if (p.mods & (1 << x)) dispatchKey(compileKey(firstSpecial + x), press);
+    dispatchKey(compileKey(p.key), press);
+}
+
+// Play the next step of the macro, if one is playing or was asked for
+inline void macroStep(MacroPlayer &p, const uint8_t *table, unsigned long now) {
+    if (!p.playing) {
+        if (!macroQueued) return;
+        p.at = macroFind(table, macroQueued - firstMacro);
+        macroQueued = 0;
+        p.playing = true;
+        p.wait = 0;
+    }
+    if (p.held) {
+        macroKeys(p, false);
+        p.held = false;
+        return;
+    }
+    if (p.wait) {
+        if (now - p.waitStart < p.wait) return;
+        p.wait = 0;
+    }
+    p.mods = 0;
+    while (p.at < MACRO_BYTES) {
+        uint8_t code = table[p.at++];
+        if (code == MACRO_END) break;
+        if (code >= MACRO_CTRL && code <= MACRO_GUI) p.mods |= 1 << (code - MACRO_CTRL);
+        else if (code == MACRO_WAIT) {
+            if (p.at < MACRO_BYTES) p.wait = table[p.at++] * 10;
+            p.waitStart = now;
+            return;
+        }
+        else {
+            p.key = code;
+            macroKeys(p, true);
+            p.held = true;
+            return;
+        }
+    }
+    p.playing = false;
+}
@@ -1,10 +1,31 @@
 // Libraries
 #include <Arduino.h>
-#include <Bounce2.h>
 #include <HID-Project.h>
 #include <Adafruit_NeoPixel.h>
-// Pins, mappings, and board-specific libraries in this file
+// Model table and board-specific libraries in this file
 #include <models.h>
+#include <keycodes.h>
+#include <macro.h>
+#include <debounce.h>
+#ifdef MATRIX
+#include <matrix.h>
+#endif
+#include <scheduler.h>
+#include <neodma.h>
+#include <color.h>
+#include <protocol.h>
+#include <console.h>
+#include <settings.h>
+#include <profile.h>
+#include <latency.h>
+#include <memory.h>
+#include <power.h>
+#include <rate.h>
+#ifdef TOUCH
+#include <ptc.h>
+#include <touch.h>
+#include <capture.h>
+#endif
 #include <FlashAsEEPROM.h>
 
 #ifndef LED_TYPE
@@ -12,11 +33,109 @@
 #endif
 Adafruit_NeoPixel pixels(numleds, neopin, LED_TYPE); 
 
-Bounce * bounce = new Bounce[numkeys];
+// Bytes per LED, RGBW types have the white offset set apart from red
+#define LED_BYTES ((((LED_TYPE) >> 6) & 3) == (((LED_TYPE) >> 4) & 3) ? 3 : 4)
+
+// Last frame sent, so unchanged frames aren't sent again
+static uint8_t ledLast[numleds * LED_BYTES];
+static bool ledSent;
+static uint16_t ledFramesSent;
+static uint16_t ledFramesSkipped;
+
+#ifdef NEO_DMA
+// Frame being sent by DMA
+static uint8_t ledFrame[WS2812_ENCODED_SIZE(numleds * LED_BYTES)];
+#endif
+
+// Thresholds and key mapping, the model's defaults until settings are loaded
+static uint8_t threshold[numkeys];
+static uint8_t mapping[numkeys];
+
+#ifdef TOUCH
+Adafruit_FreeTouch qt[numkeys];
+#endif
+
+#ifndef TOUCH
+// Debounce state for direct-pin and matrix models
+static Debouncer debouncer;
+#endif
+
+#ifdef MATRIX
+// Port group and pin mask of each row and column
+static MatrixLine rowLines[rows];
+static MatrixLine colLines[cols];
+// Scans where a rectangle of keys held some of them back
+static uint32_t matrixBlocked;
+#else
+// Gather the key bits of direct-pin models from the port groups, unrolled
+// so each key is a test against a constant mask (pins are active low)
+template <uint8_t X> struct PinScan {
+    static inline uint32_t read(const uint32_t *in) {
+        return PinScan<X-1>::read(in) | ((in[keyGroup(X-1)] & keyMask(X-1)) ? 0 : 1ul << (X-1));
+    }
+};
+template <> struct PinScan<0> {
+    static inline uint32_t read(const uint32_t *) { return 0; }
+};
+#endif
+
+// Held keys, one bit per key, and the state last reported
+static volatile uint32_t keysDown;
+static uint32_t lastKeysDown;
+inline bool keyDown(uint8_t x) { return (keysDown >> x) & 1; }
+// Any of the keys LED x shows is held
+inline bool ledDown(uint8_t x) { return keysDown & keypad.ledKeys[x]; }
+
+// All text output goes through here, see console.h
+static Console console;
+
+// Scan timer state, see TC3_Handler()
+static volatile ScanStats scanStats;
+
+// Loop profiling, see profile.h. The scan interrupt's time also lands in
+// whichever loop stage it interrupted.
+enum { PROF_SCAN, PROF_EFFECTS, PROF_KEYBOARD, PROF_IDLE, PROF_SERIAL, PROF_LOOP, PROF_STAGES };
+const char *const profileNames[PROF_STAGES] = { "checkKeys", "effects", "keyboard", "idle", "serialCheck", "loop" };
+static ProfileStage profile[PROF_STAGES];
+// Loops slower than this hold up key reports (us)
+#define LOOP_BUDGET 1000
+static uint32_t loopsOverBudget;
+
+// Edge to report latency for each key, see latency.h. Off until "#lat on".
+static LatencyTracker latency;
+static ProfileStage latencyPress[numkeys];
+static ProfileStage latencyRelease[numkeys];
+
+// Scan timing since the last call, then start over
+ScanStats scanTake() {
+    __disable_irq();
+    ScanStats scans = { scanStats.ticks, scanStats.last, scanStats.minPeriod, scanStats.maxPeriod, scanStats.late };
+    scanReset(scanStats);
+    __enable_irq();
+    return scans;
+}
+
+void profileClear() {
+    __disable_irq();
+    for (uint8_t x=0; x<PROF_STAGES; x++) profileReset(profile[x]);
+    loopsOverBudget = 0;
+    __enable_irq();
+}
 
-// buffer for keypresses
-static bool pressed[numkeys];
-static bool lastPressed[numkeys];
+#ifdef TOUCH
+// Touch conversions and their results. Pads are written to the back buffer
+// as they finish and the buffers swap once every pad has a new value, so
+// tv() always returns one complete sweep.
+static PtcScanner ptc;
+static uint8_t tvBuffer[2][numkeys];
+static volatile uint8_t tvFront;
+inline const uint8_t *tv() { return tvBuffer[tvFront]; }
+static TouchPad touchPad[numkeys];
+// When the conversion in progress started, for latency
+static unsigned long ptcStarted;
+// Raw samples for tuning, see capture.h. Off until "#cap on".
+static TouchCapture capture;
+#endif
 
 // Starting and max brightness
 static uint8_t b = 127;
@@ -25,27 +144,61 @@ static uint8_t bMax = b;
 // Default LED mode
 static uint8_t ledMode = 0;
 
-// Default debounce interval
-static uint8_t debounceInterval = 4;
+// Default debounce interval (the release window in every mode) and press
+// window for asymmetric mode, both per key
+#define DEBOUNCE_INTERVAL 4
+#define PRESS_INTERVAL 1
+static uint8_t debounceMode = DEBOUNCE_STABLE;
+static uint8_t debounceInterval[numkeys];
+static uint8_t pressInterval[numkeys];
+// Press window of each key in the current mode
+static uint8_t pressDebounce[numkeys];
+
+void debounceWindows() {
+    for (uint8_t x=0; x<numkeys; x++) pressDebounce[x] = pressWindow(debounceMode, debounceInterval[x], pressInterval[x]);
+}
+
+// Default scan rate (kHz)
+static uint8_t scanRate = 4;
 
 // Default reset value for touch pads
 static uint8_t resetValue = 12;
 
+// Press mode of each touch pad and the delta for the rapid modes (touch.h)
+#define RAPID_DELTA 10
+static uint8_t touchModes[numkeys];
+static uint8_t rapidDelta[numkeys];
+
 // Colors for custom LED mode
 // These are the initial values stored before changed through the remapper
-static uint8_t custColor[] = {224,192,224,192,224,192,224};
+static uint8_t custColor[numkeys < 7 ? 7 : numkeys] = {224,192,224,192,224,192,224};
+
+// Macro table for mapping codes from 200, empty until set
+static uint8_t macros[MACRO_BYTES];
+static MacroPlayer macroPlayer;
 
-// BPS
-static uint8_t bpsCount;
+// Keystroke rate for the BPS mode and "#bps", see rate.h
+static RateMeter keyRate;
 
 // Default idle time
 static byte idleMinutes = 5;
 
 // Millis timer for idle check
-static unsigned long pm;
+static volatile unsigned long pm;
+
+// Idle tier and time spent asleep, see power.h
+static PowerState power;
+
+// Start the scan timer at the rate for the power tier. powerWake() can
+// restart it from a key edge, so it mustn't land halfway through this.
+void scanTimerSet() {
+    __disable_irq();
+    scanTimerBegin(power.slow ? SCAN_RATE_MIN : scanRate);
+    __enable_irq();
+}
 
 // Display names for each key (in specific order, do not re-arrange)
-const String friendlyKeys[] = {
+const char *const friendlyKeys[] = {
     "L_CTRL", "L_SHIFT", "L_ALT", "L_GUI", "R_CTRL", "R_SHIFT",
     "R_ALT", "R_GUI", "ESC", "F1", "F2", "F3", "F4", "F5", "F6", "F7", "F8",
     "F9", "F10", "F11", "F12", "F13", "F14", "F15", "F16", "F17", "F18", "F19", "F20",
@@ -57,41 +210,183 @@ const String friendlyKeys[] = {
 };
 const byte numSpecial = 71;
 
-// Check if any key has been pressed in the loop.
-static bool anyPressed = 0;
+// Report type and usage for each key, compiled from mapping[]
+static KeyAction keyAction[numkeys];
+
+void compileKeymap(){
+    for (uint8_t x=0; x<numkeys; x++) keyAction[x] = compileKey(mapping[x]);
+}
+
+#ifdef TOUCH
+// Turn the saved thresholds into deltas from each pad's current baseline
+// and apply the press modes
+void captureThresholds(){
+    __disable_irq();
+    for (uint8_t x=0; x<numkeys; x++) {
+        touchCapture(touchPad[x], threshold[x], resetValue);
+        // Only on a change, since it puts the pad back at rest
+        if (touchPad[x].mode != touchModes[x] || touchPad[x].rapid != rapidDelta[x]) {
+            touchMode(touchPad[x], touchModes[x], rapidDelta[x]);
+        }
+    }
+    __enable_irq();
+}
+#endif
+
+// Saved settings. Everything is kept in RAM and only written to flash when
+// it changes (see settings.h). New fields go on the end, so records saved
+// by older firmware still load with the new fields at their defaults.
+// SETTINGS_VERSION goes up with every change to the layout, so a record
+// says which fields it has when one needs converting.
+//   1  up to scanRate, colors, mapping and threshold
+//   2  macros
+//   3  touchModes, rapidDelta
+//   4  debounceIntervals, pressIntervals (per key, the single values
+//      before them are only read from older records)
+#define SETTINGS_VERSION 4
+struct Settings {
+    uint8_t brightness;
+    uint8_t ledMode;
+    uint8_t idleMinutes;
+    uint8_t debounceInterval;
+    uint8_t resetValue;
+    uint8_t debounceMode;
+    uint8_t pressInterval;
+    uint8_t scanRate;
+    uint8_t colors[numkeys];
+    uint8_t mapping[numkeys];
+    uint8_t threshold[numkeys];
+    uint8_t macros[MACRO_BYTES];
+    uint8_t touchModes[numkeys];
+    uint8_t rapidDelta[numkeys];
+    uint8_t debounceIntervals[numkeys];
+    uint8_t pressIntervals[numkeys];
+};
+// A record is one row at most, and its length is a byte
+static_assert(sizeof(LogHeader) + sizeof(Settings) <= LOG_ROW, "settings don't fit a flash row");
+static_assert(sizeof(Settings) <= 255, "settings too long for the record length");
+
+// What's in flash now
+static Settings saved;
+static SettingsLog settingsLog;
+
+void settingsPack(Settings &s){
+    s.brightness = bMax;
+    s.ledMode = ledMode;
+    s.idleMinutes = idleMinutes;
+    s.debounceInterval = debounceInterval[0];
+    s.resetValue = resetValue;
+    s.debounceMode = debounceMode;
+    s.pressInterval = pressInterval[0];
+    s.scanRate = scanRate;
+    memcpy(s.colors, custColor, numkeys);
+    memcpy(s.mapping, mapping, numkeys);
+    memcpy(s.threshold, threshold, numkeys);
+    memcpy(s.macros, macros, MACRO_BYTES);
+    memcpy(s.touchModes, touchModes, numkeys);
+    memcpy(s.rapidDelta, rapidDelta, numkeys);
+    memcpy(s.debounceIntervals, debounceInterval, numkeys);
+    memcpy(s.pressIntervals, pressInterval, numkeys);
+}
+
+void settingsUnpack(const Settings &s){
+    bMax = s.brightness;
+    ledMode = s.ledMode;
+    idleMinutes = s.idleMinutes;
+    memcpy(debounceInterval, s.debounceIntervals, numkeys);
+    resetValue = s.resetValue;
+    debounceMode = s.debounceMode;
+    memcpy(pressInterval, s.pressIntervals, numkeys);
+    // Settings saved by older firmware don't have a mode yet
+    if (debounceMode >= DEBOUNCE_MODES) {
+        debounceMode = DEBOUNCE_STABLE;
+        memcpy(pressInterval, debounceInterval, numkeys);
+    }
+    scanRate = s.scanRate;
+    if (scanRate < SCAN_RATE_MIN || scanRate > SCAN_RATE_MAX) scanRate = 4;
+    memcpy(custColor, s.colors, numkeys);
+    memcpy(mapping, s.mapping, numkeys);
+    memcpy(threshold, s.threshold, numkeys);
+    memcpy(macros, s.macros, MACRO_BYTES);
+    memcpy(touchModes, s.touchModes, numkeys);
+    memcpy(rapidDelta, s.rapidDelta, numkeys);
+}
 
-// Leave space for general settings before colors
+// Where older firmware kept settings in emulated EEPROM
 const byte colAddr = 20;
-// Start mapping after colors in EEPROM
 const byte mapAddr = colAddr+numkeys;
 const byte threshAddr = colAddr+numkeys+numkeys;
 
-void eepromLoad(){
-    bMax = EEPROM.read(1);
-    ledMode = EEPROM.read(2);
-    idleMinutes = EEPROM.read(3);
-    debounceInterval = EEPROM.read(4);
-    resetValue = EEPROM.read(5);
+void eepromImport(Settings &s){
+    s.brightness = EEPROM.read(1);
+    s.ledMode = EEPROM.read(2);
+    s.idleMinutes = EEPROM.read(3);
+    s.debounceInterval = EEPROM.read(4);
+    s.resetValue = EEPROM.read(5);
+    s.debounceMode = EEPROM.read(6);
+    s.pressInterval = EEPROM.read(7);
+    s.scanRate = EEPROM.read(8);
     for (uint8_t x=0;x<numkeys;x++) {
-        custColor[x] = EEPROM.read(colAddr+x);
-        mapping[x] = EEPROM.read(mapAddr+x);
-        threshold[x] = EEPROM.read(threshAddr+x);
+        s.colors[x] = EEPROM.read(colAddr+x);
+        s.mapping[x] = EEPROM.read(mapAddr+x);
+        s.threshold[x] = EEPROM.read(threshAddr+x);
     }
 }
 
-void eepromUpdate(){
-    // If values don't match, update them
-    if (bMax != EEPROM.read(1)) EEPROM.write(1, bMax);
-    if (ledMode != EEPROM.read(2)) EEPROM.write(2, ledMode);
-    if (idleMinutes != EEPROM.read(3)) EEPROM.write(3, idleMinutes);
-    if (debounceInterval != EEPROM.read(4)) EEPROM.write(4, debounceInterval);
-    if (resetValue != EEPROM.read(5)) EEPROM.write(5, resetValue);
-    for (uint8_t x=0; x<numkeys; x++) {
-        if (custColor[x] != EEPROM.read(colAddr+x)) EEPROM.write(colAddr+x, custColor[x]);
-        if (mapping[x] != EEPROM.read(mapAddr+x)) EEPROM.write(mapAddr+x, mapping[x]);
-        if (threshold[x] != EEPROM.read(threshAddr+x)) EEPROM.write(threshAddr+x, threshold[x]);
+// Write the settings to flash if they changed and apply them
+void settingsSave(){
+    Settings s;
+    settingsPack(s);
+    if (memcmp(&s, &saved, sizeof(s))) {
+        logSave(settingsLog, SETTINGS_VERSION, &s, sizeof(s));
+        saved = s;
+    }
+    compileKeymap();
+#ifdef TOUCH
+    captureThresholds();
+#endif
+}
+
+void settingsLoad(){
+    // Start from the defaults so fields the record doesn't have keep them
+    Settings s;
+    settingsPack(s);
+    uint8_t version = logLoad(settingsLog, &s, sizeof(s));
+    bool found = version;
+    // Nothing saved yet, bring over what older firmware left in EEPROM
+    if (!found && EEPROM.isValid()) eepromImport(s);
+    // Older records and EEPROM have one pair of windows for every key
+    if (version < 4) {
+        memset(s.debounceIntervals, s.debounceInterval, numkeys);
+        memset(s.pressIntervals, s.pressInterval, numkeys);
     }
-    EEPROM.commit();
+    settingsUnpack(s);
+    settingsPack(saved);
+    if (!found) logSave(settingsLog, SETTINGS_VERSION, &saved, sizeof(saved));
+    compileKeymap();
+#ifdef TOUCH
+    captureThresholds();
+#endif
+}
+
+// Send the pixels to the strip if they changed since the last frame
+void ledShow() {
+    const uint8_t *frame = pixels.getPixels();
+    if (ledSent && !memcmp(frame, ledLast, sizeof(ledLast))) {
+        ledFramesSkipped++;
+        return;
+    }
+#ifdef NEO_DMA
+    // Frames are at least 10ms apart, so one still going out is just skipped
+    // (and sent next time, since ledLast isn't updated)
+    if (neoDmaBusy()) return;
+    neoDmaStart(ledFrame, ws2812Encode(frame, sizeof(ledLast), ledFrame));
+#else
+    pixels.show();
+#endif
+    memcpy(ledLast, frame, sizeof(ledLast));
+    ledSent = true;
+    ledFramesSent++;
 }
 
 void setup() {
@@ -105,18 +400,26 @@ void setup() {
 
     // Initialize LEDs
     pixels.begin();
-    pixels.show();
+#ifdef NEO_DMA
+    neoDmaBegin();
+#endif
+    ledShow();
 
-    // Initialize EEPROM
-    if (!EEPROM.isValid()) eepromUpdate();
-    else eepromLoad();
+    // Load settings over the model's defaults
+    memcpy(threshold, keypad.threshold, numkeys);
+    memcpy(mapping, keypad.mapping, numkeys);
+    memset(rapidDelta, RAPID_DELTA, numkeys);
+    memset(debounceInterval, DEBOUNCE_INTERVAL, numkeys);
+    memset(pressInterval, PRESS_INTERVAL, numkeys);
+    settingsLoad();
 
 // Initialize touchpads
 #ifdef TOUCH
     for (uint8_t x=0; x<numkeys; x++) {
-        qt[x] = Adafruit_FreeTouch(pins[x], OVERSAMPLE_8, RESISTOR_50K, FREQ_MODE_NONE),
+        qt[x] = Adafruit_FreeTouch(keypad.pins[x], OVERSAMPLE_8, RESISTOR_50K, FREQ_MODE_NONE),
         qt[x].begin();
     }
+    ptcBegin(ptc, keypad.pins, OVERSAMPLE_8, RESISTOR_50K);
     #ifdef XIAO
     pinMode(11, INPUT_PULLUP);
     pinMode(12, INPUT_PULLUP);
@@ -126,12 +429,13 @@ void setup() {
     digitalWrite(12, HIGH);
     #endif
 #else
-    // Set pullups and attach pins to debounce lib with debounce time (in ms)
-    for (uint8_t x=0; x<numkeys; x++) {
-        pinMode(pins[x], INPUT_PULLUP);
-        bounce[x].attach(pins[x]);
-        bounce[x].interval(debounceInterval);
-    }
+#ifdef MATRIX
+    matrixBegin(keypad.pins, rowLines, rows, keypad.pins + rows, colLines, cols);
+#else
+    for (uint8_t x=0; x<numkeys; x++) pinMode(keypad.pins[x], INPUT_PULLUP);
+#endif
+    // Work out the press windows for the debounce mode
+    debounceWindows();
     pinMode(11, INPUT_PULLUP);
     pinMode(12, INPUT_PULLUP);
     pinMode(13, INPUT_PULLUP);
@@ -139,176 +443,159 @@ void setup() {
 
     NKROKeyboard.begin();
     Mouse.begin();
+
+    // Start scanning
+    scanReset(scanStats);
+    profileClear();
+    powerClear(power);
+    scanTimerSet();
 }
 
-unsigned long touchMillis;
-uint8_t tv[numkeys];
+#ifndef TOUCH
+// Stamp edges away from the reported level. One that went back and stayed
+// there for the longer debounce window was never going to be reported.
+void latencyPins(uint32_t raw, uint32_t edges, unsigned long now) {
+    uint32_t away = raw ^ lastKeysDown;
+    latencyEdge(latency, edges & away, now);
+    uint32_t back = latency.pending & ~away & ~(keysDown ^ lastKeysDown);
+    while (back) {
+        uint8_t x = __builtin_ctz(back);
+        unsigned long settle = (pressDebounce[x] > debounceInterval[x] ? pressDebounce[x] : debounceInterval[x]) * 1000ul;
+        if (now - debouncer.changed[x] >= settle) latencyCancel(latency, 1ul << x);
+        back &= back - 1;
+    }
+}
+#endif
 
 void checkKeys() {
-    anyPressed = 0;
 #if defined (TOUCH)
-    if ((millis() - touchMillis) > 0) {
-        for (uint8_t x=0; x<numkeys; x++) tv[x] = qt[x].measure()/4;
-        for (uint8_t x=0; x<numkeys; x++) {
-            if (tv[x] > threshold[x]) pressed[x] = 0;
-            else if ( tv[x] < threshold[x] - resetValue ) pressed[x] = 1;
+    // Collect the pad that finished, the next one is already converting
+    uint16_t value;
+    int8_t x = ptcPoll(ptc, value);
+    if (x < 0) return;
+    if (capture.enabled) captureSample(capture, numkeys, x, value, micros());
+    uint8_t v = touchValue(value);
+    tvBuffer[!tvFront][x] = v;
+    bool held = touchUpdate(touchPad[x], v, keyDown(x), resetValue);
+    if (latency.enabled) {
+        // The sample that crossed was being taken since the last one finished
+        unsigned long now = micros();
+        if (held != keyDown(x)) {
+            // Crossing back before the first crossing was reported is noise
+            if (held == ((lastKeysDown >> x) & 1)) latencyCancel(latency, 1ul << x);
+            else latencyEdge(latency, 1ul << x, ptcStarted);
         }
-        touchMillis = millis();
+        ptcStarted = now;
     }
+    if (held) keysDown |= 1ul << x;
+    else keysDown &= ~(1ul << x);
+    if (x == numkeys-1) tvFront = !tvFront;
 #else
-// Regular models can just iterate with a for loop.
-    for(uint8_t x=0; x<numkeys; x++){
-        bounce[x].update();
-        pressed[x] = bounce[x].read();
-        if (!pressed[x]) anyPressed = 1;
+#ifdef MATRIX
+    uint32_t raw = matrixScan(rowLines, rows, colLines, cols);
+    // Keys that might be ghosts keep their last level until it's clear
+    uint32_t ghosts = matrixGhosts(raw, rows, cols);
+    if (ghosts) {
+        raw = (raw & ~ghosts) | (debouncer.raw & ghosts);
+        matrixBlocked++;
     }
+#else
+    // Read each port group once, then gather the key bits
+    uint32_t in[2] = { PORT->Group[0].IN.reg, PORT->Group[1].IN.reg };
+    uint32_t raw = PinScan<numkeys>::read(in);
+#endif
+    unsigned long now = micros();
+    uint32_t edges = raw ^ debouncer.raw;
+    keysDown = debounce(debouncer, raw, now, pressDebounce, debounceInterval);
+    if (latency.enabled) latencyPins(raw, edges, now);
 #endif
-    // Always update anyPressed
-    for(uint8_t x=0; x<numkeys; x++) if (!pressed[x]) anyPressed = 1;
+}
+
+// Scan timer
+void TC3_Handler() {
+    TC3->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+    unsigned long start = micros();
+    scanRecord(scanStats, start, power.slow ? SCAN_RATE_MIN : scanRate);
+    checkKeys();
+    profileRecord(profile[PROF_SCAN], micros() - start);
 }
 
 // Check x key state
 void serialCheck(uint8_t x) {
-    Serial.print("Key ");
-    Serial.print(x+1);
-    Serial.print(" has been ");
-    if (pressed[x] == 0) Serial.println("pressed.");
-    if (pressed[x] == 1) Serial.println("released.");
+    console.print("Key ");
+    console.print(x+1);
+    console.print(" has been ");
+    if (keyDown(x)) console.println("pressed.");
+    else console.println("released.");
+}
+
+// The report with the queued keys went to the USB stack
+void latencyReported() {
+    if (!latency.queued) return;
+    __disable_irq();
+    latencySent(latency, micros(), lastKeysDown, latencyPress, latencyRelease);
+    __enable_irq();
 }
 
 void keyboard() {
-    for (uint8_t x=0; x<numkeys; x++){
-        // If the button state changes, press/release a key.
-        if ( pressed[x] != lastPressed[x] ){
+    // If the last report hasn't gone out, leave new edges in keysDown so
+    // they're picked up once the endpoint is free again.
+    if (!flushReports()) return;
+    latencyReported();
+    // Only keys whose state changed since the last report
+    uint32_t down = keysDown;
+    uint32_t changed = down ^ lastKeysDown;
+    __disable_irq();
+    latencyQueue(latency, changed);
+    __enable_irq();
+    while (changed) {
+        uint8_t x = __builtin_ctz(changed);
 #ifdef DEBUG
-            serialCheck(x); // Only prints on state change
-#endif
-            if (!pressed[x]) bpsCount++;
-            pm = millis();
-            // Check press state and press/release key
-            switch(mapping[x]){
-                // Key exceptions need to go here for NKROKeyboard
-                // It would be really nice if there was a better way to do this,
-                // but NKROKeyboard requires the literal key definition
-                case 128: if (!pressed[x]) KBP(KEY_LEFT_CTRL); if (pressed[x]) KBR(KEY_LEFT_CTRL); break;
-                case 129: if (!pressed[x]) KBP(KEY_LEFT_SHIFT); if (pressed[x]) KBR(KEY_LEFT_SHIFT); break;
-                case 130: if (!pressed[x]) KBP(KEY_LEFT_ALT); if (pressed[x]) KBR(KEY_LEFT_ALT); break;
-                case 131: if (!pressed[x]) KBP(KEY_LEFT_GUI); if (pressed[x]) KBR(KEY_LEFT_GUI); break;
-                case 132: if (!pressed[x]) KBP(KEY_RIGHT_CTRL); if (pressed[x]) KBR(KEY_RIGHT_CTRL); break;
-                case 133: if (!pressed[x]) KBP(KEY_RIGHT_SHIFT); if (pressed[x]) KBR(KEY_RIGHT_SHIFT); break;
-                case 134: if (!pressed[x]) KBP(KEY_RIGHT_ALT); if (pressed[x]) KBR(KEY_RIGHT_ALT); break;
-                case 135: if (!pressed[x]) KBP(KEY_RIGHT_GUI); if (pressed[x]) KBR(KEY_RIGHT_GUI); break;
-                case 136: if (!pressed[x]) KBP(KEY_ESC); if (pressed[x]) KBR(KEY_ESC); break;
-                case 137: if (!pressed[x]) KBP(KEY_F1); if (pressed[x]) KBR(KEY_F1); break;
-                case 138: if (!pressed[x]) KBP(KEY_F2); if (pressed[x]) KBR(KEY_F2); break;
-                case 139: if (!pressed[x]) KBP(KEY_F3); if (pressed[x]) KBR(KEY_F3); break;
-                case 140: if (!pressed[x]) KBP(KEY_F4); if (pressed[x]) KBR(KEY_F4); break;
-                case 141: if (!pressed[x]) KBP(KEY_F5); if (pressed[x]) KBR(KEY_F5); break;
-                case 142: if (!pressed[x]) KBP(KEY_F6); if (pressed[x]) KBR(KEY_F6); break;
-                case 143: if (!pressed[x]) KBP(KEY_F7); if (pressed[x]) KBR(KEY_F7); break;
-                case 144: if (!pressed[x]) KBP(KEY_F8); if (pressed[x]) KBR(KEY_F8); break;
-                case 145: if (!pressed[x]) KBP(KEY_F9); if (pressed[x]) KBR(KEY_F9); break;
-                case 146: if (!pressed[x]) KBP(KEY_F10); if (pressed[x]) KBR(KEY_F10); break;
-                case 147: if (!pressed[x]) KBP(KEY_F11); if (pressed[x]) KBR(KEY_F11); break;
-                case 148: if (!pressed[x]) KBP(KEY_F12); if (pressed[x]) KBR(KEY_F12); break;
-                case 149: if (!pressed[x]) KBP(KEY_F13); if (pressed[x]) KBR(KEY_F13); break;
-                case 150: if (!pressed[x]) KBP(KEY_F14); if (pressed[x]) KBR(KEY_F14); break;
-                case 151: if (!pressed[x]) KBP(KEY_F15); if (pressed[x]) KBR(KEY_F15); break;
-                case 152: if (!pressed[x]) KBP(KEY_F16); if (pressed[x]) KBR(KEY_F16); break;
-                case 153: if (!pressed[x]) KBP(KEY_F17); if (pressed[x]) KBR(KEY_F17); break;
-                case 154: if (!pressed[x]) KBP(KEY_F18); if (pressed[x]) KBR(KEY_F18); break;
-                case 155: if (!pressed[x]) KBP(KEY_F19); if (pressed[x]) KBR(KEY_F19); break;
-                case 156: if (!pressed[x]) KBP(KEY_F20); if (pressed[x]) KBR(KEY_F20); break;
-                case 157: if (!pressed[x]) KBP(KEY_F21); if (pressed[x]) KBR(KEY_F21); break;
-                case 158: if (!pressed[x]) KBP(KEY_F22); if (pressed[x]) KBR(KEY_F22); break;
-                case 159: if (!pressed[x]) KBP(KEY_F23); if (pressed[x]) KBR(KEY_F23); break;
-                case 160: if (!pressed[x]) KBP(KEY_F24); if (pressed[x]) KBR(KEY_F24); break;
-                case 161: if (!pressed[x]) KBP(KEY_ENTER); if (pressed[x]) KBR(KEY_ENTER); break;
-                case 162: if (!pressed[x]) KBP(KEY_BACKSPACE); if (pressed[x]) KBR(KEY_BACKSPACE); break;
-                case 163: if (!pressed[x]) KBP(KEY_TAB); if (pressed[x]) KBR(KEY_TAB); break;
-                case 164: if (!pressed[x]) KBP(KEY_PRINT); if (pressed[x]) KBR(KEY_PRINT); break;
-                case 165: if (!pressed[x]) KBP(KEY_PAUSE); if (pressed[x]) KBR(KEY_PAUSE); break;
-                case 166: if (!pressed[x]) KBP(KEY_INSERT); if (pressed[x]) KBR(KEY_INSERT); break;
-                case 167: if (!pressed[x]) KBP(KEY_HOME); if (pressed[x]) KBR(KEY_HOME); break;
-                case 168: if (!pressed[x]) KBP(KEY_PAGE_UP); if (pressed[x]) KBR(KEY_PAGE_UP); break;
-                case 169: if (!pressed[x]) KBP(KEY_DELETE); if (pressed[x]) KBR(KEY_DELETE); break;
-                case 170: if (!pressed[x]) KBP(KEY_END); if (pressed[x]) KBR(KEY_END); break;
-                case 171: if (!pressed[x]) KBP(KEY_PAGE_DOWN); if (pressed[x]) KBR(KEY_PAGE_DOWN); break;
-                case 172: if (!pressed[x]) KBP(KEY_RIGHT); if (pressed[x]) KBR(KEY_RIGHT); break;
-                case 173: if (!pressed[x]) KBP(KEY_LEFT); if (pressed[x]) KBR(KEY_LEFT); break;
-                case 174: if (!pressed[x]) KBP(KEY_DOWN); if (pressed[x]) KBR(KEY_DOWN); break;
-                case 175: if (!pressed[x]) KBP(KEY_UP); if (pressed[x]) KBR(KEY_UP); break;
-                case 176: if (!pressed[x]) KBP(KEYPAD_DIVIDE); if (pressed[x]) KBR(KEYPAD_DIVIDE); break;
-                case 177: if (!pressed[x]) KBP(KEYPAD_MULTIPLY); if (pressed[x]) KBR(KEYPAD_MULTIPLY); break;
-                case 178: if (!pressed[x]) KBP(KEYPAD_SUBTRACT); if (pressed[x]) KBR(KEYPAD_SUBTRACT); break;
-                case 179: if (!pressed[x]) KBP(KEYPAD_ADD); if (pressed[x]) KBR(KEYPAD_ADD); break;
-                case 180: if (!pressed[x]) KBP(KEYPAD_ENTER); if (pressed[x]) KBR(KEYPAD_ENTER); break;
-                case 181: if (!pressed[x]) KBP(KEYPAD_1); if (pressed[x]) KBR(KEYPAD_1); break;
-                case 182: if (!pressed[x]) KBP(KEYPAD_2); if (pressed[x]) KBR(KEYPAD_2); break;
-                case 183: if (!pressed[x]) KBP(KEYPAD_3); if (pressed[x]) KBR(KEYPAD_3); break;
-                case 184: if (!pressed[x]) KBP(KEYPAD_4); if (pressed[x]) KBR(KEYPAD_4); break;
-                case 185: if (!pressed[x]) KBP(KEYPAD_5); if (pressed[x]) KBR(KEYPAD_5); break;
-                case 186: if (!pressed[x]) KBP(KEYPAD_6); if (pressed[x]) KBR(KEYPAD_6); break;
-                case 187: if (!pressed[x]) KBP(KEYPAD_7); if (pressed[x]) KBR(KEYPAD_7); break;
-                case 188: if (!pressed[x]) KBP(KEYPAD_8); if (pressed[x]) KBR(KEYPAD_8); break;
-                case 189: if (!pressed[x]) KBP(KEYPAD_9); if (pressed[x]) KBR(KEYPAD_9); break;
-                case 190: if (!pressed[x]) KBP(KEYPAD_0); if (pressed[x]) KBR(KEYPAD_0); break;
-                case 191: if (!pressed[x]) KBP(KEY_MENU); if (pressed[x]) KBR(KEY_MENU); break;
-                case 192: if (!pressed[x]) KBP(KEY_VOLUME_MUTE); if (pressed[x]) KBR(KEY_VOLUME_MUTE); break;
-                case 193: if (!pressed[x]) KBP(KEY_VOLUME_UP); if (pressed[x]) KBR(KEY_VOLUME_UP); break;
-                case 194: if (!pressed[x]) KBP(KEY_VOLUME_DOWN); if (pressed[x]) KBR(KEY_VOLUME_DOWN); break;
-                case 195: if (!pressed[x]) Mouse.press(MOUSE_LEFT); if (pressed[x]) Mouse.release(MOUSE_LEFT); break;
-                case 196: if (!pressed[x]) Mouse.press(MOUSE_RIGHT); if (pressed[x]) Mouse.release(MOUSE_RIGHT); break;
-                case 197: if (!pressed[x]) Mouse.press(MOUSE_MIDDLE); if (pressed[x]) Mouse.release(MOUSE_MIDDLE); break;
-                case 198: if (!pressed[x]) Mouse.press(MOUSE_PREV); if (pressed[x]) Mouse.release(MOUSE_PREV); break;
-                case 199: if (!pressed[x]) Mouse.press(MOUSE_NEXT); if (pressed[x]) Mouse.release(MOUSE_NEXT); break;
-                default: if (!pressed[x]) KBP(mapping[x]); if (pressed[x]) KBR(mapping[x]); break;
-            }
-            // Save last pressed state to buffer
-            lastPressed[x] = pressed[x];
-        }
+        serialCheck(x); // Only prints on state change
+#endif
+        if ((down >> x) & 1) rateStamp(keyRate, x, millis());
+        pm = millis();
+        // Press/release through the compiled keymap, queued into this scan's report
+        dispatchKey(keyAction[x], (down >> x) & 1);
+        changed &= changed - 1;
     }
+    lastKeysDown = down;
+    // Next press or release of a macro that's playing
+    macroStep(macroPlayer, macros, millis());
+    // One keyboard and one mouse report for every edge in this scan
+    if (flushReports()) latencyReported();
 }
 
-uint32_t hsv_mult = 256;
-
 // Cycle through rainbow
 void wheel(){
     static uint8_t hue;
-#if numleds == 1
-    if (anyPressed == 0) pixels.setPixelColor(0, pixels.ColorHSV(hue*hsv_mult, 255, b));
-    else pixels.setPixelColor(0, pixels.ColorHSV(255, 0, b));
-#else
     for(uint8_t i = 0; i < numleds; i++) {
-        if (pressed[i]) pixels.setPixelColor(i, pixels.ColorHSV((hue+(i*20))*hsv_mult, 255, b));
-        else pixels.setPixelColor(i, pixels.ColorHSV(255, 0, b));
+        if (!ledDown(i)) pixels.setPixelColor(i, ledColor(hue+(i*20)));
+        else pixels.setPixelColor(i, ledColor(0, 0));
     }
-#endif
     hue--;
-    pixels.show();
+    ledShow();
 }
 
 // Highlight the key being remapped.
 static uint8_t selected;
 void highlightSelected(){
     uint8_t hue = (255/numkeys);
-    for(uint8_t i = 0; i < numkeys; i++) {
-        pixels.setPixelColor(i, pixels.ColorHSV(hue*hsv_mult, 255, b));
-        if (i == selected) pixels.setPixelColor(i, pixels.ColorHSV(255, 0, b)); 
+    for(uint8_t i = 0; i < numleds; i++) {
+        pixels.setPixelColor(i, ledColor(hue));
+        // Only an LED of its own can show which key it is
+        if (keypad.ledKeys[i] == 1ul << selected) pixels.setPixelColor(i, ledColor(0, 0));
     }
-#if numleds == 1
-    if (anyPressed == 0) pixels.setPixelColor(0, pixels.ColorHSV(hue*hsv_mult, 255, b));
-#endif
-    pixels.show();
+    ledShow();
 }
 
 // Fade from white to rainbow to off
 void rbFade(){
     static int hue; // Though these are 0-255, they are saved as ints to allow overflow
-    static int sat[numkeys];
-    static int val[numkeys];
-    for(int i = 0; i < numkeys; i++) {
-        if (!pressed[i]) {
+    static int sat[numleds];
+    static int val[numleds];
+    for(int i = 0; i < numleds; i++) {
+        if (ledDown(i)) {
             if (sat[i] < 255) sat[i] = sat[i]+8;
             if (sat[i] > 255) sat[i] = 255; // Keep saturation within byte range
             if (sat[i] == 255 && val[i] > 0) val[i] = val[i]-8;
@@ -319,77 +606,48 @@ void rbFade(){
             val[i]=255;
         }
         //leds[i] = CHSV(hue+(i*50),sat[i],val[i]);
-        pixels.setPixelColor(i, pixels.ColorHSV((hue+(i*50))*hsv_mult, sat[i], val[i] * b / 255));
-    }
-#if numleds == 1
-    static int satDS;
-    static int valDS;
-    if (anyPressed) {
-        if (satDS < 255) satDS = satDS+8;
-        if (satDS > 255) satDS = 255; // Keep saturation within byte range
-        if (satDS == 255 && valDS > 0) valDS = valDS-8;
-        if (valDS < 0) valDS = 0; // Same for val
+        pixels.setPixelColor(i, ledColor(hue+(i*50), sat[i], val[i]));
     }
-    else { satDS=0; valDS=255; }
-    //leds[0] = CHSV(hue,satDS,valDS);
-    pixels.setPixelColor(0, pixels.ColorHSV(hue*hsv_mult, satDS, valDS * b / 255));
-#endif
     hue-=8;
     if (hue < 0) hue = 255;
-    pixels.show();
+    ledShow();
 }
 
 // Custom colors
 void custom(){
-    // Iterate through keys
-    for(int i = 0; i < numkeys; i++) {
-        // adjust LED order for special keypads
-        if (pressed[i]) pixels.setPixelColor(i, pixels.ColorHSV(custColor[i]*hsv_mult, 255, b));
-        else pixels.setPixelColor(i, pixels.ColorHSV(255, 0, b));
+    // Iterate through LEDs
+    for(int i = 0; i < numleds; i++) {
+        if (!ledDown(i)) pixels.setPixelColor(i, ledColor(custColor[i]));
+        else pixels.setPixelColor(i, ledColor(0, 0));
     }
-#if numleds == 1
-    if (anyPressed == 0) pixels.setPixelColor(0, pixels.ColorHSV(custColor[0]*hsv_mult, 255, b));
-    else pixels.setPixelColor(0, pixels.ColorHSV(255, 0, b));
-#endif
-    pixels.show();
+    ledShow();
 }
 
-static unsigned long avgMillis;
-static uint16_t bpsColor;
+// Hue follows the tapping rate, one step for each tenth of a press a second
 static uint16_t lastColor;
-int incValue;
 void bps(){
-    // Update values once per second
-    if ((millis() - avgMillis) > 1000) {
-        lastColor = bpsColor;
-        bpsColor = (bpsCount*10);
-        bpsCount = 0;
-        avgMillis = millis();
-    }
+    uint16_t bpsColor = rateRead(keyRate, millis(), 0xffffffff).rate;
+    if (bpsColor > 255) bpsColor = 255;
 
     uint8_t bpsSpeed = 3;
-    // Inc/dec values to smooth transition
+    // Inc/dec values to smooth transition, landing on the rate
     if (lastColor > bpsColor) {
-        lastColor-=bpsSpeed;
         if (lastColor - bpsColor < bpsSpeed) lastColor=bpsColor;
+        else lastColor-=bpsSpeed;
     }
     if (lastColor < bpsColor){
-        lastColor+=bpsSpeed;
         if (bpsColor - lastColor < bpsSpeed) lastColor=bpsColor;
+        else lastColor+=bpsSpeed;
     }
 
-    uint8_t finalColor = lastColor%256;
+    uint8_t finalColor = lastColor;
 
     for(int i = 0; i < numleds; i++) {
-        if (pressed[i]) pixels.setPixelColor(i, pixels.ColorHSV((finalColor+100)*hsv_mult, 255, b));
-        else pixels.setPixelColor(i, pixels.ColorHSV(255, 0, b));
+        if (!ledDown(i)) pixels.setPixelColor(i, ledColor(finalColor+100));
+        else pixels.setPixelColor(i, ledColor(0, 0));
     }
-#if numleds == 1
-    if (anyPressed == 0) pixels.setPixelColor(0, pixels.ColorHSV((finalColor+100)*hsv_mult, 255, b));
-    else pixels.setPixelColor(0, pixels.ColorHSV(255, 0, b));
-#endif
     //FastLED.show();
-    pixels.show();
+    ledShow();
 
 }
 
@@ -397,6 +655,8 @@ static unsigned long effectMillis;
 void effects(uint8_t speed, uint8_t MODE) {
     // All LED modes should go here for universal speed control
     if ((millis() - effectMillis) > speed){
+        // Rebuild the brightness table if it's fading
+        colorBrightness(b);
         // Select LED mode
         switch(MODE){
             case 0:
@@ -412,8 +672,9 @@ void effects(uint8_t speed, uint8_t MODE) {
         }
 
         // Fade brightness on idle change
-        if (b < bMax) b++;
-        if (b > bMax) b--;
+        uint8_t target = power.tier == POWER_ACTIVE ? bMax : 0;
+        if (b < target) b++;
+        if (b > target) b--;
 
         effectMillis = millis();
     }
@@ -424,35 +685,71 @@ static int count;
 void serialDebug() {
     count++;
     if ((millis() - serialDebugMillis) > 1000){
-        // Print brightness and EEPROM brightness
-        Serial.print("Brightness: "); Serial.print(b); Serial.print(" / "); Serial.println(EEPROM.read(1));
-        // Print EEPROM LED mode
-        Serial.print("LED mode: "); Serial.println(EEPROM.read(2));
-        // Print EEPROM idle timeout
-        Serial.print("Idle timeout: "); Serial.println(EEPROM.read(3));
+        // Print brightness and saved brightness
+        console.print("Brightness: "); console.print(b); console.print(" / "); console.println(saved.brightness);
+        // Print saved LED mode
+        console.print("LED mode: "); console.println(saved.ledMode);
+        // Print saved idle timeout
+        console.print("Idle timeout: "); console.println(saved.idleMinutes);
+        // Print settings saves since the log was started
+        console.print("Settings saves: "); console.println(settingsLog.sequence);
         // Print loops per second
-        Serial.print("LPS: ");Serial.println(count);
+        console.print("LPS: ");console.println(count);
+        // Print scan timing since the last print
+        ScanStats scans = scanTake();
+        console.print("Scans: "); console.print(scans.ticks);
+        console.print(" (period "); console.print(scans.minPeriod); console.print("-"); console.print(scans.maxPeriod);
+        console.print("us, "); console.print(scans.late); console.println(" late)");
+#ifdef MATRIX
+        console.print("Ghost blocked scans: "); console.println(matrixBlocked);
+#endif
+        // Print the tapping rate over the last second
+        Rate r = rateRead(keyRate, millis(), 0xffffffff);
+        console.print("Rate: "); console.print(r.rate / 10); console.print("."); console.print(r.rate % 10);
+        console.print("/s (peak "); console.print(keyRate.peak / 10); console.print("."); console.print(keyRate.peak % 10);
+        console.print(", UR "); console.print(r.unstable); console.println(")");
+        // Print how many LED frames were unchanged and not sent
+        console.print("LED frames: "); console.print(ledFramesSent); console.print(" sent, ");
+        console.print(ledFramesSkipped); console.print(" unchanged (");
+        console.print(ledFramesSkipped * 100ul / (ledFramesSent + ledFramesSkipped ? ledFramesSent + ledFramesSkipped : 1));
+        console.println("% skipped)");
+        ledFramesSent = ledFramesSkipped = 0;
+        // Print console output lost to a slow or missing terminal
+        console.print("Console dropped: "); console.println(console.dropped);
         // Print seconds since last keypress (idle debugging)
-        Serial.print("Seconds since last keypress: ");Serial.println((millis() - pm)/1000);
+        console.print("Seconds since last keypress: ");console.println((millis() - pm)/1000);
         // Print idle minutes var
-        Serial.print("Idle minutes: ");Serial.println(idleMinutes);
+        console.print("Idle minutes: ");console.println(idleMinutes);
+        // Print the power tier and how long the core was awake
+        console.print("Power tier: "); console.print(power.tier);
+        console.print(" (awake "); console.print(powerDuty(power) / 10); console.println("%)");
 
+#ifdef TOUCH
         // Print current threshold values
-        Serial.print("Touch sensitivity: ");
+        console.print("Touch sensitivity: ");
         for (uint8_t x=0; x<numkeys; x++) {
-            Serial.print(threshold[x]);
-            if (x<numkeys-1) Serial.print(", ");
-            else Serial.println();
+            console.print(threshold[x]);
+            if (x<numkeys-1) console.print(", ");
+            else console.println();
         }
 
         // Print touch values
-        Serial.print("Touch values: ");
+        console.print("Touch values: ");
         for (uint8_t x=0; x<numkeys; x++) {
-            Serial.print(tv[x]);
-            if (x<numkeys-1) Serial.print(", ");
-            else Serial.println();
+            console.print(tv()[x]);
+            if (x<numkeys-1) console.print(", ");
+            else console.println();
         }
 
+        // Print resting values the thresholds are measured from
+        console.print("Touch baselines: ");
+        for (uint8_t x=0; x<numkeys; x++) {
+            console.print(touchBaseline(touchPad[x]));
+            if (x<numkeys-1) console.print(", ");
+            else console.println();
+        }
+#endif
+
         count = 0;
         serialDebugMillis = millis();
     }
@@ -460,80 +757,109 @@ void serialDebug() {
 
 // Menu text
 void greet(){
-    Serial.println(F("Enter 'c' to start the configurator."));
-    Serial.println(F("(Keys on the keypad are disabled while the configurator is open.)"));
+    console.println(F("Enter 'c' to start the configurator."));
+    console.println(F("(Keys on the keypad are disabled while the configurator is open.)"));
 }
 void menu(){
-    Serial.println(F("Welcome to the configurator! Enter:"));
-    Serial.println(F("0 to save and exit"));
-    Serial.println(F("1 to remap keys"));
-    Serial.println(F("2 to set the LED mode"));
-    Serial.println(F("3 to set the brightness"));
-    Serial.println(F("4 to set the custom colors"));
-    Serial.println(F("5 to set the idle timeout"));
+    console.println(F("Welcome to the configurator! Enter:"));
+    console.println(F("0 to save and exit"));
+    console.println(F("1 to remap keys"));
+    console.println(F("2 to set the LED mode"));
+    console.println(F("3 to set the brightness"));
+    console.println(F("4 to set the custom colors"));
+    console.println(F("5 to set the idle timeout"));
 #ifdef TOUCH
-    Serial.println(F("6 to set the touch sensitivity"));
-    Serial.println(F("7 to auto-calibrate touch sensitivity"));
-    Serial.println(F("8 to set the touchpad reset value"));
+    console.println(F("6 to set the touch sensitivity"));
+    console.println(F("7 to auto-calibrate touch sensitivity"));
+    console.println(F("8 to set the touchpad reset value"));
+    console.println(F("9 to set the scan rate"));
 #else
-    Serial.println(F("6 to set the debounce interval"));
+    console.println(F("6 to set the debounce interval"));
+    console.println(F("7 to set the debounce mode"));
+    console.println(F("8 to set the scan rate"));
 #endif
 }
 void LEDmodes(){
-    Serial.println(F("Select an LED mode. Enter:"));
-    Serial.println(F("0 for Cycle"));
-    Serial.println(F("1 for Reactive"));
-    Serial.println(F("2 for Custom"));
-    Serial.println(F("3 for BPS"));
+    console.println(F("Select an LED mode. Enter:"));
+    console.println(F("0 for Cycle"));
+    console.println(F("1 for Reactive"));
+    console.println(F("2 for Custom"));
+    console.println(F("3 for BPS"));
 }
 void custExp(){
-    Serial.println(F("Please enter a color value for the respective key."));
-    Serial.println(F("Colors are expressed as a 0-255 value, where:"));
-    Serial.println(F("red=0, orange=32, yellow=64, green=96"));
-    Serial.println(F("aqua=128, blue=160, purple=192, and pink=224"));
-    Serial.print(F("Current values: "));
+    console.println(F("Please enter a color value for the respective key."));
+    console.println(F("Colors are expressed as a 0-255 value, where:"));
+    console.println(F("red=0, orange=32, yellow=64, green=96"));
+    console.println(F("aqua=128, blue=160, purple=192, and pink=224"));
+    console.print(F("Current values: "));
     for (uint8_t x=0;x<numleds;x++) {
-        Serial.print(custColor[x]);
-        if (x != numleds-1) Serial.print(", ");
+        console.print(custColor[x]);
+        if (x != numleds-1) console.print(", ");
     }
 }
 void remapExp(){
-    Serial.println(F("If you're trying to map a key that doesn't print a character,"));
-    Serial.println(F("please use one of the codes below with a ':' in front of it."));
+    console.println(F("If you're trying to map a key that doesn't print a character,"));
+    console.println(F("please use one of the codes below with a ':' in front of it."));
 }
 void brightExp(){
-    Serial.println(F("Enter a brightness value between 0 and 255."));
-    Serial.print(F("Current value: "));
-    Serial.print(bMax);
+    console.println(F("Enter a brightness value between 0 and 255."));
+    console.print(F("Current value: "));
+    console.print(bMax);
 }
 void idleExp(){
-    Serial.println(F("Please enter an idle timeout value in minutes between 0 and 255."));
-    Serial.println(F("A value of 0 will disable the idle timeout feature."));
-    Serial.print(F("Current value: "));
-    Serial.println(idleMinutes);
+    console.println(F("Please enter an idle timeout value in minutes between 0 and 255."));
+    console.println(F("A value of 0 will disable the idle timeout feature."));
+    console.print(F("Current value: "));
+    console.println(idleMinutes);
 }
 void resetExp(){
-    Serial.println(F("Please enter a touchpad reset value between 0 and 255."));
-    Serial.println(F("This value determines how much force is required for the release of a pad."));
-    Serial.println(F("A sane value is 5-15. Below 5 is not recommended as it may cause"));
-    Serial.println(F("the pad to spam inputs."));
-    Serial.print(F("Current value: "));
-    Serial.println(resetValue);
+    console.println(F("Please enter a touchpad reset value between 0 and 255."));
+    console.println(F("This value determines how much force is required for the release of a pad."));
+    console.println(F("A sane value is 5-15. Below 5 is not recommended as it may cause"));
+    console.println(F("the pad to spam inputs."));
+    console.print(F("Current value: "));
+    console.println(resetValue);
+}
+void scanRateExp(){
+    console.println(F("Enter a scan rate in kHz between 1 and 8."));
+    console.println(F("Higher rates lower input latency but leave less time for LEDs."));
+    console.print(F("Current value: "));
+    console.print(scanRate);
 }
 void debounceExp(){
-    Serial.println(F("Enter a debounce value between 0 and 255."));
-    Serial.println(F("A sane value is 2-10."));
-    Serial.print(F("Current value: "));
-    Serial.print(debounceInterval);
+    console.println(F("Enter a debounce value between 0 and 255, for every key."));
+    console.println(F("A sane value is 2-10. Keys can have their own with #set debounce=4,6,..."));
+    console.print(F("Current values: "));
+    for (uint8_t x=0; x<numkeys; x++) {
+        console.print(debounceInterval[x]);
+        if (x<numkeys-1) console.print(", ");
+    }
+}
+void debounceModes(){
+    console.println(F("Select a debounce mode. Enter:"));
+    console.println(F("0 for Stable (presses and releases both wait for the debounce interval)"));
+    console.println(F("1 for Eager (presses are sent immediately, releases wait)"));
+    console.println(F("2 for Asymmetric (presses use their own interval)"));
+    console.print(F("Current value: "));
+    console.println(debounceMode);
+}
+void pressExp(){
+    console.println(F("Enter a press debounce value between 0 and 255."));
+    console.println(F("Releases still use the debounce interval. A sane value is 0-4."));
+    console.print(F("Current values: "));
+    for (uint8_t x=0; x<numkeys; x++) {
+        console.print(pressInterval[x]);
+        if (x<numkeys-1) console.print(", ");
+    }
 }
 void thresholdExp(){
-    Serial.println(F("Enter a sensitivity value for each pad between 0 and 255 (higher is less sensitive.)"));
-    Serial.println(F("A sane value is 150-225."));
-    Serial.print(F("Current values: "));
+    console.println(F("Enter a sensitivity value for each pad between 0 and 255 (higher is less sensitive.)"));
+    console.println(F("A sane value is 150-225."));
+    console.print(F("Current values: "));
     for (uint8_t x=0; x<numkeys; x++) {
-        Serial.print(threshold[x]);
-        if (x<numkeys-1) Serial.print(", ");
-        else Serial.println();
+        console.print(threshold[x]);
+        if (x<numkeys-1) console.print(", ");
+        else console.println();
     }
 }
 
@@ -542,47 +868,47 @@ void keyTable() {
     remapExp();
     uint8_t lineLength = 0;
     // Print top line of table
-    for (int y = 0; y < 69; y++) Serial.print("-");
-    Serial.println();
+    for (int y = 0; y < 69; y++) console.print("-");
+    console.println();
     for (int x = 0; x <= numSpecial; x++) {
-        if (lineLength == 0) Serial.print("| ");
+        if (lineLength == 0) console.print("| ");
         // Make every line wrap at 30 characters
-        uint8_t nameLength = friendlyKeys[x].length(); // save as variable within for loop for repeated use
+        uint8_t nameLength = strlen(friendlyKeys[x]); // save as variable within for loop for repeated use
         lineLength += nameLength + 6;
-        Serial.print(friendlyKeys[x]);
+        console.print(friendlyKeys[x]);
         nameLength = 9 - nameLength;
         while (nameLength > 0) { // Print a space
-            Serial.print(" ");
+            console.print(" ");
             lineLength++;
             nameLength--;
         }
         if (x > 9) lineLength++;
-        Serial.print(" = ");
+        console.print(" = ");
         if (x <= 9) {
-            Serial.print(" ");
+            console.print(" ");
             lineLength+=2;
         }
-        Serial.print(x);
-        Serial.print(" | ");
+        console.print(x);
+        console.print(" | ");
         if (lineLength > 55) {
             lineLength = 0;
-            Serial.println();
+            console.println();
         }
     }
     // If line isn't finished, create newline
-    if (lineLength != 0) Serial.println();
+    if (lineLength != 0) console.println();
     // Print bottom line of table
-    for (int y = 0; y < 69; y++) Serial.print("-");
-    Serial.println();
-    Serial.println(F("For example, enter :8 to map escape"));
-    Serial.println();
+    for (int y = 0; y < 69; y++) console.print("-");
+    console.println();
+    console.println(F("For example, enter :8 to map escape"));
+    console.println();
 }
 
 void keyLookup(uint8_t inByte) {
     for (uint8_t x=0; x<=numSpecial;x++) {
-        if (inByte == 128+x) { Serial.print(friendlyKeys[x]); return; }
+        if (inByte == 128+x) { console.print(friendlyKeys[x]); return; }
     }
-    Serial.print(char(inByte));
+    console.print(char(inByte));
 }
 
 // This funciton is redundant
@@ -606,10 +932,10 @@ void printBlock(uint8_t block) {
             break;
         case 5: // Remapper
             // Print key names and numbers
-            Serial.println();
-            Serial.println(F("Current values: "));
-            for (uint8_t x=0;x<numkeys;x++) { keyLookup(mapping[x]); if (x<numkeys-1) Serial.print(", "); }
-            Serial.println();
+            console.println();
+            console.println(F("Current values: "));
+            for (uint8_t x=0;x<numkeys;x++) { keyLookup(mapping[x]); if (x<numkeys-1) console.print(", "); }
+            console.println();
             break;
         case 6: // Brightness
             debounceExp();
@@ -619,10 +945,11 @@ void printBlock(uint8_t block) {
             break;
     }
     // Add extra line break
-    Serial.println();
+    console.println();
 }
 
-const String modeNames[]={ "Cycle", "Reactive", "Custom", "BPS" };
+const char *const modeNames[]={ "Cycle", "Reactive", "Custom", "BPS" };
+const char *const debounceNames[]={ "Stable", "Eager", "Asymmetric" };
 void ledMenu() {
     printBlock(2);
     while(true){
@@ -630,61 +957,44 @@ void ledMenu() {
         if (incomingByte > 0){
             if (incomingByte>=48&&incomingByte<=51) {
                 ledMode = incomingByte-48;
-                Serial.print(F("Selected "));
-                Serial.println(modeNames[ledMode]);
-                Serial.println();
+                console.print(F("Selected "));
+                console.println(modeNames[ledMode]);
+                console.println();
                 return;
             }
-            else Serial.println(F("Please enter a valid value."));
+            else console.println(F("Please enter a valid value."));
         }
     }
 }
 
-// Converts incoming string chars to a byte
+// Adds one typed digit to a number, saturating so a long run of digits
+// still reads as out of range
+inline void digitFeed(uint16_t &value, char c) {
+    value = value < 1000 ? value * 10 + (c - '0') : value;
+}
+
+// Converts incoming digits to a byte
 int parseByte(){
-    String inString = "";    // string to hold input
+    uint16_t value = 0;
     bool start=0;
     while (true) {
         int incomingByte = Serial.read();
         if (incomingByte > 0) {
             start=1;
             // Parse input
-            if (isDigit(incomingByte)) {
-              // convert the incoming byte to a char and add it to the string:
-              inString += (char)incomingByte;
-            }
+            if (isDigit(incomingByte)) digitFeed(value, incomingByte);
         }
         // Convert to byte after receiving block
         if (incomingByte <= 0 && start == 1) {
-            int value = inString.toInt();
-            inString = "";
-            if (value >= 0 && value <= 255) { start=0; return value; }
-            else { start = 0; Serial.print(value); Serial.println(F(" is invalid. Please enter a valid value.")); }
+            if (value <= 255) return value;
+            start = 0; console.print(value); console.println(F(" is invalid. Please enter a valid value."));
+            value = 0;
         }
     }
 }
 
-// Converts incoming string chars to a byte
-bool enterMenu(){
-    String inString = "";    // string to hold input
-    char inChar = Serial.read();
-    // Wait for characters to stop coming in
-    while (Serial.read() > 0) {
-        inString += inChar;
-    }
-    // Then process
-    if (inString == "menu") {
-        inString = "";
-        return 1;
-    }
-    else {
-        inString = "";
-        return 0;
-    }
-}
-
 uint8_t parseKey() {
-    String inString = "";    // string to hold input
+    uint16_t value = 0;
     bool start=0;
     while (true) {
         // Highlight active key
@@ -703,20 +1013,34 @@ uint8_t parseKey() {
         // If the first byte was a colon, start appending.
         else if (inByte > 0 && start == 1) {
             // Append if number, otherwise complain and start over.
-            if (isDigit(inByte)) {
-              // convert the incoming byte to a char and add it to the string:
-              inString += (char)inByte;
-            }
-            else { inString=""; start=0; Serial.println(F("Please enter a valid value.")); }
+            if (isDigit(inByte)) digitFeed(value, inByte);
+            else { value=0; start=0; console.println(F("Please enter a valid value.")); }
         }
         // If block is finished being sent
         if (inByte <= 0 && start == 1) {
-            // Convert string to int
-            int value = inString.toInt();
-            if (value >= 0 && value <= numSpecial) return 128+value;
+            if (value <= numSpecial) return 128+value;
             // Otherwise, restart
-            else { inString=""; start = 0; Serial.print(value); Serial.println(F(" is invalid. Please enter a valid value.")); }
+            else { console.print(value); console.println(F(" is invalid. Please enter a valid value.")); value=0; start = 0; }
+        }
+    }
+}
+
+// Menu for changing the scan rate
+void scanRateMenu(){
+    scanRateExp();
+    console.println();
+    while(true){
+        uint8_t rate = parseByte();
+        if (rate >= SCAN_RATE_MIN && rate <= SCAN_RATE_MAX) {
+            console.print(F("Entered value: "));
+            console.println(rate);
+            console.println();
+            scanRate = rate;
+            scanTimerSet();
+            return;
         }
+        console.print(rate);
+        console.println(F(" is invalid. Please enter a valid value."));
     }
 }
 
@@ -724,9 +1048,9 @@ uint8_t parseKey() {
 uint8_t brightMenu(){
     while(true){
         uint8_t temp = parseByte();
-        Serial.print(F("Entered value: "));
-        Serial.println(temp);
-        Serial.println();
+        console.print(F("Entered value: "));
+        console.println(temp);
+        console.println();
         return temp;
     }
 }
@@ -736,15 +1060,15 @@ void customMenu(){
     printBlock(4);
     while(true){
         for(uint8_t x=0;x<numleds;x++){
-            Serial.print(F("Color for key "));
-            Serial.print(x+1);
-            Serial.print(": ");
+            console.print(F("Color for key "));
+            console.print(x+1);
+            console.print(": ");
             uint8_t color = parseByte();
-            Serial.println(color);
+            console.println(color);
             custColor[x] = color;
             effects(10,2);
         }
-        Serial.println();
+        console.println();
         // Give user a second to see new color.
         // Confirmation would make more sense here.
         delay(1000);
@@ -758,14 +1082,14 @@ void thresholdMenu(){
     printBlock(7);
     while(true){
         for(uint8_t x=0;x<numkeys;x++){
-            Serial.print(F("Sensitivity for key "));
-            Serial.print(x+1);
-            Serial.print(": ");
+            console.print(F("Sensitivity for key "));
+            console.print(x+1);
+            console.print(": ");
             uint8_t new_thresh = parseByte();
-            Serial.println(new_thresh);
+            console.println(new_thresh);
             threshold[x] = new_thresh;
         }
-        Serial.println();
+        console.println();
         return;
     }
 }
@@ -783,45 +1107,78 @@ void remapMenu(){
         // Subtract 1 because array is 0 indexed
         mapping[x] = key;
         // Separate by comma if not last value
-        if (x<numkeys) Serial.print(F(", "));
+        if (x<numkeys) console.print(F(", "));
         // Otherwise, create newline
-        else Serial.println();
+        else console.println();
+    }
+    console.println();
+}
+
+#ifndef TOUCH
+void debounceMenu() {
+    debounceModes();
+    console.println();
+    while(true){
+        int incomingByte = Serial.read();
+        if (incomingByte > 0){
+            if (incomingByte>=48&&incomingByte<48+DEBOUNCE_MODES) {
+                debounceMode = incomingByte-48;
+                console.print(F("Selected "));
+                console.println(debounceNames[debounceMode]);
+                console.println();
+                break;
+            }
+            else console.println(F("Please enter a valid value."));
+        }
+    }
+    if (debounceMode == DEBOUNCE_ASYMMETRIC) {
+        pressExp();
+        console.println();
+        uint8_t value = parseByte();
+        memset(pressInterval, value, numkeys);
+        console.print(F("Entered value: "));
+        console.println(value);
+        console.println();
     }
-    Serial.println();
+    debounceWindows();
 }
+#endif
 
 #ifdef TOUCH
 void touch_calibrate() {
-    Serial.println("Your touch pads will now be auto-calibrated.");
-    Serial.println("Please press each pad in order with as much force");
-    Serial.println("as you would like for them to be actuated with,");
-    Serial.println("and wait for confirmation between pads.");
+    console.println("Your touch pads will now be auto-calibrated.");
+    console.println("Please press each pad in order with as much force");
+    console.println("as you would like for them to be actuated with,");
+    console.println("and wait for confirmation between pads.");
     static uint8_t mv[numkeys];
     for (uint8_t x=0; x<numkeys; x++) {
-        static uint8_t init_value = tv[x];
+        static uint8_t init_value = tv()[x];
         // If the touch value hasn't increased by 10
-        while (tv[x] - init_value <= 5) {
-            checkKeys(); // Update values or we'll get stuck forever
+        // (values keep updating from the scan timer)
+        while (tv()[x] - init_value <= 5) {
             delay(1); // Speed limit with delay, only check once per ms
         }
         // If the touch value has increased by 9
-        while (tv[x] - init_value > 4) {
-            checkKeys(); // Update values
-            if (tv[x] > mv[x]) mv[x] = tv[x]; // Update max value if touch value is higher
+        while (tv()[x] - init_value > 4) {
+            if (tv()[x] > mv[x]) mv[x] = tv()[x]; // Update max value if touch value is higher
             delay(1); // Speed limit with delay, only check once per ms
         }
-        Serial.print("Value for pad ");
-        Serial.print(x+1);
-        Serial.print(": ");
+        console.print("Value for pad ");
+        console.print(x+1);
+        console.print(": ");
         threshold[x] = ((mv[x] - init_value)/2) + init_value;
-        Serial.println(threshold[x]);
+        console.println(threshold[x]);
     }
-    Serial.println();
+    console.println();
 }
 #endif
 
 // Main menu
+// Blocks until '0' is entered, with no key reports and no '#' lines read
+// meanwhile. Configurators use the '#' protocol instead, see protocol.h.
 void mainmenu() {
+    // The menus wait for input anyway, so print straight to the host
+    console.sync = true;
     printBlock(1);
     while(true){
         int incomingByte = Serial.read();
@@ -831,10 +1188,11 @@ void mainmenu() {
             // Wait for a value to match
             switch(incomingByte-48){
                 case(0):
-                    Serial.println(F("Settings saved! Exiting..."));
-                    eepromUpdate();
+                    console.println(F("Settings saved! Exiting..."));
+                    settingsSave();
                     printBlock(0);
                     pm = millis(); // Reset idle counter post-config
+                    console.sync = false;
                     return;
                     break;
                 case(1):
@@ -876,60 +1234,364 @@ void mainmenu() {
 #else
                 case(6):
                     debounceExp();
-                    debounceInterval = brightMenu();
-                    for (uint8_t x=0; x<numkeys; x++) bounce[x].interval(debounceInterval);
+                    memset(debounceInterval, brightMenu(), numkeys);
+                    debounceWindows();
+                    printBlock(1);
+                    break;
+                case(7):
+                    debounceMenu();
                     printBlock(1);
                     break;
 #endif
+#ifdef TOUCH
+                case(9):
+#else
+                case(8):
+#endif
+                    scanRateMenu();
+                    printBlock(1);
+                    break;
                 default:
-                    Serial.println(F("Please enter a valid value."));
+                    console.println(F("Please enter a valid value."));
                     break;
             }
         }
     }
 }
 
+// Everything the config protocol can read and write
+const Setting settings[] = {
+    { "bright", &bMax, 1, 0, 255, false },
+    { "mode", &ledMode, 1, 0, 3, false },
+    { "idle", &idleMinutes, 1, 0, 255, false },
+    { "rate", &scanRate, 1, SCAN_RATE_MIN, SCAN_RATE_MAX, false },
+#ifdef TOUCH
+    { "reset", &resetValue, 1, 0, 255, false },
+    { "thresh", threshold, numkeys, 0, 255, false },
+    { "tmode", touchModes, numkeys, 0, TOUCH_MODES-1, false },
+    { "rapid", rapidDelta, numkeys, 1, 255, false },
+#else
+    { "debounce", debounceInterval, numkeys, 0, 255, false },
+    { "dbmode", &debounceMode, 1, 0, DEBOUNCE_MODES-1, false },
+    { "press", pressInterval, numkeys, 0, 255, false },
+#endif
+    { "map", mapping, numkeys, 0, 255, false },
+    { "color", custColor, numkeys, 0, 255, false },
+    { "macro", macros, MACRO_BYTES, 0, 255, true },
+};
+const uint8_t numSettings = sizeof(settings) / sizeof(settings[0]);
+
+// Reply with every setting
+void configPrint() {
+    console.print(F("#cfg keys=")); console.print(numkeys);
+    console.print(F(" leds=")); console.print(numleds);
+    protocolPrint(console, settings, numSettings);
+    console.println();
+}
+
+// Reply with the profile, straight to the host since it's too long to buffer
+void profileDump() {
+    console.sync = true;
+    for (uint8_t x=0; x<PROF_STAGES; x++) {
+        __disable_irq();
+        ProfileStage stage = profile[x];
+        __enable_irq();
+        console.print(F("#prof ")); console.print(profileNames[x]);
+        profilePrint(console, stage);
+    }
+    console.print(F("#prof over=")); console.print(loopsOverBudget);
+    console.print(F(" budget=")); console.println(LOOP_BUDGET);
+    console.sync = false;
+}
+
+// Reply with the latency histograms, press and release for each key
+void latencyDump() {
+    console.sync = true;
+    for (uint8_t x=0; x<numkeys; x++) {
+        __disable_irq();
+        ProfileStage press = latencyPress[x];
+        ProfileStage release = latencyRelease[x];
+        __enable_irq();
+        console.print(F("#lat ")); console.print(x+1); console.print(F(" press"));
+        profilePrint(console, press);
+        console.print(F("#lat ")); console.print(x+1); console.print(F(" release"));
+        profilePrint(console, release);
+    }
+    console.sync = false;
+}
+
+void latencyEnable(bool on) {
+    __disable_irq();
+    for (uint8_t x=0; x<numkeys; x++) {
+        profileReset(latencyPress[x]);
+        profileReset(latencyRelease[x]);
+    }
+    latency.pending = 0;
+    latency.queued = 0;
+    latency.enabled = on;
+#ifdef TOUCH
+    ptcStarted = micros();
+#endif
+    __enable_irq();
+    console.println(on ? F("#lat on") : F("#lat off"));
+}
+
+#ifdef TOUCH
+// Stop capturing and send what's in the buffer. The header has what the
+// replay tool needs to start where the firmware was.
+void captureDump() {
+    captureEnable(capture, false);
+    console.sync = true;
+    console.print(F("#cap pads=")); console.print(numkeys);
+    console.print(F(" sweeps=")); console.print(capture.records);
+    console.print(F(" reset=")); console.print(resetValue);
+    console.print(F(" thresh="));
+    for (uint8_t x=0; x<numkeys; x++) {
+        if (x) console.print(',');
+        console.print(threshold[x]);
+    }
+    console.print(F(" tmode="));
+    for (uint8_t x=0; x<numkeys; x++) {
+        if (x) console.print(',');
+        console.print(touchModes[x]);
+    }
+    console.print(F(" rapid="));
+    for (uint8_t x=0; x<numkeys; x++) {
+        if (x) console.print(',');
+        console.print(rapidDelta[x]);
+    }
+    console.print(F(" base="));
+    for (uint8_t x=0; x<numkeys; x++) {
+        if (x) console.print(',');
+        console.print(capture.baseline[x]);
+    }
+    console.println();
+    captureWrite(capture, numkeys, console);
+    console.println(F("#cap end"));
+    console.sync = false;
+}
+
+void captureStart() {
+    for (uint8_t x=0; x<numkeys; x++) capture.baseline[x] = touchBaseline(touchPad[x]);
+    captureEnable(capture, true);
+    console.println(F("#cap on"));
+}
+#endif
+
+// Reply with the power tier and the share of time awake since the last
+// "#power", then start counting again
+void powerDump() {
+    uint16_t duty = powerDuty(power);
+    console.print(F("#power tier=")); console.print(power.tier);
+    console.print(F(" slow=")); console.print(power.slow);
+    console.print(F(" duty=")); console.print(duty / 10); console.print('.'); console.print(duty % 10);
+    console.print(F(" sleeps=")); console.print(power.sleeps);
+    console.print(F(" wakes=")); console.println(power.wakes);
+    powerClear(power);
+}
+
+// Reply with the scan timing since the last "#scan", see scheduler.h
+void scanDump() {
+    ScanStats scans = scanTake();
+    console.print(F("#scan rate=")); console.print(power.slow ? SCAN_RATE_MIN : scanRate);
+    console.print(F(" ticks=")); console.print(scans.ticks);
+    console.print(F(" min=")); console.print(scans.ticks > 1 ? scans.minPeriod : 0);
+    console.print(F(" max=")); console.print(scans.maxPeriod);
+    console.print(F(" late=")); console.println(scans.late);
+}
+
+// Presses since the last "#bps reset", all keys together
+uint32_t rateTotal() {
+    uint32_t total = 0;
+    for (uint8_t x=0; x<numkeys; x++) total += keyRate.presses[x];
+    return total;
+}
+
+// The rest of a "#bps" line, rates in presses a second
+void ratePrint(const Rate &r, uint16_t peak, uint32_t total) {
+    console.print(F(" rate=")); console.print(r.rate / 10); console.print('.'); console.print(r.rate % 10);
+    console.print(F(" peak=")); console.print(peak / 10); console.print('.'); console.print(peak % 10);
+    console.print(F(" ur=")); console.print(r.unstable);
+    console.print(F(" n=")); console.print(r.presses);
+    console.print(F(" total=")); console.println(total);
+}
+
+// Reply with the rate of all keys together, then of each key
+void rateDump() {
+    console.sync = true;
+    unsigned long now = millis();
+    console.print(F("#bps all"));
+    ratePrint(rateRead(keyRate, now, 0xffffffff), keyRate.peak, rateTotal());
+    for (uint8_t x=0; x<numkeys; x++) {
+        console.print(F("#bps ")); console.print(x+1);
+        ratePrint(rateRead(keyRate, now, 1ul << x), keyRate.keyPeak[x], keyRate.presses[x]);
+    }
+    console.sync = false;
+}
+
+// After "#bps on", send the "#bps all" line every RATE_STREAM_MS while
+// there are presses in the window, and once more when there aren't
+#define RATE_STREAM_MS 100
+static bool rateStreaming;
+static bool rateStreamQuiet;
+static unsigned long rateStreamMillis;
+void rateStream() {
+    if (!rateStreaming || millis() - rateStreamMillis < RATE_STREAM_MS) return;
+    rateStreamMillis = millis();
+    Rate r = rateRead(keyRate, rateStreamMillis, 0xffffffff);
+    if (!r.presses && rateStreamQuiet) return;
+    rateStreamQuiet = !r.presses;
+    console.print(F("#bps all"));
+    ratePrint(r, keyRate.peak, rateTotal());
+}
+
+// Handle one '#' line
+void configCommand(char *line) {
+    if (!strcmp(line, "get")) { configPrint(); return; }
+    if (!strcmp(line, "prof")) { profileDump(); return; }
+    if (!strcmp(line, "prof reset")) { profileClear(); profileDump(); return; }
+    if (!strcmp(line, "mem")) {
+        console.print(F("#mem static=")); console.print(memStatic());
+        console.print(F(" heap=")); console.print(memHeap());
+        console.print(F(" free=")); console.print(memFree());
+#ifdef TOUCH
+        // Part of static, the biggest single buffer
+        console.print(F(" capture=")); console.print(sizeof(capture.ring));
+#endif
+        console.println();
+        return;
+    }
+    if (!strcmp(line, "lat")) { latencyDump(); return; }
+    if (!strcmp(line, "power")) { powerDump(); return; }
+    if (!strcmp(line, "scan")) { scanDump(); return; }
+    if (!strcmp(line, "lat on")) { latencyEnable(true); return; }
+    if (!strcmp(line, "lat off")) { latencyEnable(false); return; }
+    if (!strcmp(line, "bps")) { rateDump(); return; }
+    if (!strcmp(line, "bps reset")) { rateClear(keyRate); rateDump(); return; }
+    if (!strcmp(line, "bps on") || !strcmp(line, "bps off")) {
+        rateStreaming = !strcmp(line, "bps on");
+        rateStreamQuiet = false;
+        console.println(rateStreaming ? F("#bps on") : F("#bps off"));
+        return;
+    }
+#ifdef TOUCH
+    if (!strcmp(line, "cap")) { captureDump(); return; }
+    if (!strcmp(line, "cap on")) { captureStart(); return; }
+#endif
+    if (!strncmp(line, "set ", 4)) {
+        uint8_t rate = scanRate;
+        int8_t bad = protocolParse(line+4, settings, numSettings, false);
+        if (bad < 0) {
+            protocolParse(line+4, settings, numSettings, true);
+            debounceWindows();
+            if (scanRate != rate) scanTimerSet();
+            settingsSave();
+            configPrint();
+            return;
+        }
+        console.print(F("#err "));
+        console.println(bad < numSettings ? settings[bad].name : "unknown");
+        return;
+    }
+    console.println(F("#err command"));
+}
+
+static LineReader configLine;
 static unsigned long remapMillis;
 static unsigned long enterMillis;
 void serialCheck() {
-    // Check for serial connection every 1s
+    // Push greeting
     if ((millis() - remapMillis) > 1000){
-        // Push greeting
         if ((millis() - enterMillis) > 5000){
             printBlock(0);
             enterMillis = millis();
         }
+        remapMillis = millis();
+    }
 
-        // Check incoming character if exists
-        if (Serial.available() > 0) {
-            char inChar = Serial.read();
-            // If special key is received, enter the configurator
-            if (inChar == 'c') mainmenu();
-        }
+    // Take whatever has arrived, a bit at a time so the loop keeps going
+    for (uint8_t x=0; x<64 && Serial.available() > 0; x++) {
+        char inChar = Serial.read();
+        if (lineFeed(configLine, inChar)) configCommand(configLine.buf);
+        // If special key is received outside a config line, enter the configurator
+        else if (inChar == 'c' && !configLine.active) mainmenu();
+    }
+}
 
-        remapMillis = millis();
+// A key edge while the scan rate is down: put it back and scan now. The
+// scan runs from the timer interrupt, so it can't land inside another one.
+void powerWake() {
+    if (!power.slow) return;
+    power.slow = false;
+    power.wakes++;
+    pm = millis();
+    scanTimerBegin(scanRate);
+    NVIC_SetPendingIRQ(TC3_IRQn);
+}
+
+void powerEnter(uint8_t tier, bool slow) {
+    // Direct-pin keys wake the scan on their first edge, one per EIC line
+    if (keypad.input == KEYS_PINS) {
+        uint16_t lines = 0;
+        for (uint8_t x=0; x<numkeys; x++) {
+            bool lineFree = !keyNmi(x) && !(lines & (1 << keyLine(x)));
+            if (slow && lineFree) attachInterrupt(keypad.pins[x], powerWake, FALLING);
+            else detachInterrupt(keypad.pins[x]);
+            if (lineFree) lines |= 1 << keyLine(x);
+        }
     }
+    power.slow = slow;
+    scanTimerSet();
+    power.tier = tier;
 }
 
+// Pick the power tier from the USB bus and the time since the last key
 void idle(){
-    if (idleMinutes != 0) {
-        if ((millis() - pm) > idleMinutes*60000) bMax = 0;
-        // Restore from EEPROM value here
-        else bMax = EEPROM.read(1);
-    }
+    unsigned long now = millis();
+    uint8_t tier = POWER_ACTIVE;
+    if (powerSuspended(power, now)) tier = POWER_SUSPEND;
+    else if (idleMinutes != 0 && (now - pm) > idleMinutes*60000ul) tier = POWER_IDLE;
+    // Touch has no pin change to wake on, so idle keeps the full rate
+    bool slow = tier == POWER_SUSPEND || (tier == POWER_IDLE && keypad.input == KEYS_PINS);
+    if (tier != power.tier || slow != power.slow) powerEnter(tier, slow);
 }
 
 void loop() {
-    // Update key state to check for button presses
+    uint32_t start = micros();
+    uint32_t mark = start;
+    // Keys are scanned from the timer interrupt. Touch pads are polled here
+    // too, so the next conversion starts as soon as one finishes instead of
+    // waiting for the next tick.
+#ifdef TOUCH
+    __disable_irq();
     checkKeys();
-    // Make lights happen
-    effects(10, ledMode);
+    profileMark(profile[PROF_SCAN], mark);
+    __enable_irq();
+#endif
+    // Make lights happen, until they've faded out for idle
+    if (power.tier == POWER_ACTIVE || b) effects(10, ledMode);
+    else {
+        pixels.clear();
+        ledShow();
+    }
+    profileMark(profile[PROF_EFFECTS], mark);
     // Convert key presses to actual keyboard keys
     keyboard();
+    profileMark(profile[PROF_KEYBOARD], mark);
     idle();
+    profileMark(profile[PROF_IDLE], mark);
     // Debug check for loops per second
 #ifdef DEBUG
     serialDebug();
 #endif
+    rateStream();
     serialCheck();
+    // Pass on a packet of console output to an open terminal
+    console.drain();
+    profileMark(profile[PROF_SERIAL], mark);
+    profileRecord(profile[PROF_LOOP], mark - start);
+    if (mark - start > LOOP_BUDGET) loopsOverBudget++;
+    // Nothing else to do until the next scan, key edge or USB interrupt.
+    // Touch pads keep converting from the scan tick while the core sleeps.
+    if (power.tier != POWER_ACTIVE) powerSleep(power);
 }
@@ -0,0 +1,24 @@
+// Memory use
+// Nothing is allocated after setup() (NeoPixel's buffer is the only heap
+// use), so the heap never gives anything back and the program break is its
+// high-water mark. Static RAM is .data and .bss from the linker script;
+// what's between the break and the stack pointer is what the stack has
+// left. "#mem" reports all three, and on touch models the capture ring
+// inside the static figure (capture.h).
+#pragma once
+
+#include <Arduino.h>
+
+#ifdef __arm__
+extern "C" char *sbrk(int incr);
+extern char __data_start__, __bss_end__, end;
+
+inline uint32_t memStatic() { return &__bss_end__ - &__data_start__; }
+inline uint32_t memHeap() { return sbrk(0) - &end; }
+inline uint32_t memFree() { char top; return &top - sbrk(0); }
+#else
+// The host has none of these
+inline uint32_t memStatic() { return 0; }
+inline uint32_t memHeap() { return 0; }
+inline uint32_t memFree() { return 0; }
+#endif
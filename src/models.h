@@ -1,7 +1,3 @@
-// Helps keyboard code not wrap
-#define KBP NKROKeyboard.press
-#define KBR NKROKeyboard.release
-
 // Platform specific
 #ifdef TOUCH
 #include <Adafruit_FreeTouch.h>
@@ -48,67 +44,117 @@
 #define SK_MB4   198
 #define SK_MB5   199
 
-// This whole section is really ugly.
-#ifdef TOUCH
-    // For 2x2 prototype, this should be changed to the xiao pins
-    #if defined(ALTPINS)
-        const uint8_t pins[] = { 7, 6, 0, 1 };
-        static uint8_t threshold[] = { 120, 120, 200, 150 };
-        uint8_t mapping[] = {SK_Z, SK_X, SK_ESC, SK_BKTK};
-        #warning Using alt pin mapping
-    #elif defined(XIAO)
-        // mini xiao
-        #if numkeys == 2
-            const uint8_t pins[] = { 0, 1 };
-            static uint8_t threshold[] = { 220, 220 };
-            uint8_t mapping[] = {SK_Z, SK_X };
-        // mega xiao
-        #elif numkeys == 4
-            const uint8_t pins[] = { 0, 1, 7, 8 };
-            static uint8_t threshold[] = { 220, 220, 220, 220 };
-            uint8_t mapping[] = {SK_Z, SK_X, SK_ESC, SK_BKTK};
-        // 4k mega xiao
-        #elif numkeys == 6
-            const uint8_t pins[] = { 0, 1, 6, 7, 8, 9 };
-            static uint8_t threshold[] = { 220, 225, 190, 190, 190, 190 };
-            uint8_t mapping[] = {SK_Z, SK_X, SK_C, SK_V, SK_ESC, SK_BKTK};
-        #endif
-    #else
-        // mini
-        #if numkeys == 2
-            static uint8_t threshold[] = { 200, 175 };
-            const uint8_t pins[] = { A0, A1 };
-            uint8_t mapping[] = {SK_Z, SK_X};
-        // mega
-        #elif numkeys == 4
-            static uint8_t threshold[] = { 175, 175, 150, 100 };
-            const uint8_t pins[] = { A0, A1, A2, A3 };
-            uint8_t mapping[] = {SK_Z, SK_X, SK_ESC, SK_BKTK};
-        // 6k
-        #elif numkeys == 6
-            static uint8_t threshold[] = { 170, 165, 130, 120, 110, 135 };
-            const uint8_t pins[] = { A0, A1, A2, A3, A6, A7 };
-            uint8_t mapping[] = {SK_Q, SK_W, SK_E, SK_A, SK_S, SK_D};
-        #endif
-    #endif
-#else
-    // Empty array
-    uint8_t threshold[numkeys];
+// Each model is one entry in the table below, picked with -Dmodel=<name> in
+// platformio.ini. Everything that differs between models is read from the
+// entry at compile time, so loops over keys and LEDs have constant bounds
+// and paths a model doesn't use are dropped.
+enum KeyInput { KEYS_PINS, KEYS_MATRIX, KEYS_TOUCH };
+
+// Room in each entry, keysDown has a bit per key so 32 at most
+#define MODEL_KEYS 32
+#define MODEL_LEDS 32
+
+struct Model {
+    KeyInput input;
+    uint8_t keys;
+    uint8_t leds;
+    // Matrix models list the row pins and then the column pins
+    uint8_t rows;
+    uint8_t cols;
+    uint8_t pins[MODEL_KEYS];
+    // Defaults until settings are saved
+    uint8_t threshold[MODEL_KEYS];
+    uint8_t mapping[MODEL_KEYS];
+    // Keys each LED shows, a single LED shows them all
+    uint32_t ledKeys[MODEL_LEDS];
+};
+
+namespace models {
     // 2k RGB
-    #if numkeys == 3
-    const uint8_t pins[] = { 2, 3, 1 };
-    uint8_t mapping[] = {SK_Z, SK_X, SK_ESC};
+    constexpr Model k2 = { KEYS_PINS, 3, 2, 0, 0,
+        { 2, 3, 1 }, {}, { SK_Z, SK_X, SK_ESC },
+        { 1 << 0, 1 << 1 } };
     // 4K RGB
-    #elif numkeys == 5
-    const uint8_t pins[] = { 2, 3, 8, 7, 1 };
-    uint8_t mapping[] = {SK_Z, SK_X, SK_C, SK_V, SK_ESC};
+    constexpr Model k4 = { KEYS_PINS, 5, 4, 0, 0,
+        { 2, 3, 8, 7, 1 }, {}, { SK_Z, SK_X, SK_C, SK_V, SK_ESC },
+        { 1 << 0, 1 << 1, 1 << 2, 1 << 3 } };
     // 7K RGB
-    #elif numkeys == 9
-    const uint8_t pins[] = { 1, 2, 3, 10, 9, 8, 6, 5, 7};
-    uint8_t mapping[] = {SK_S, SK_D, SK_F, SK_J, SK_K, SK_L, SK_SP, SK_ESC, SK_BKTK};
-    #endif
+    constexpr Model k7 = { KEYS_PINS, 9, 7, 0, 0,
+        { 1, 2, 3, 10, 9, 8, 6, 5, 7 }, {}, { SK_S, SK_D, SK_F, SK_J, SK_K, SK_L, SK_SP, SK_ESC, SK_BKTK },
+        { 1 << 0, 1 << 1, 1 << 2, 1 << 3, 1 << 4, 1 << 5, 1 << 6 } };
+    // 3x3 matrix
+    constexpr Model matrix3x3 = { KEYS_MATRIX, 9, 9, 3, 3,
+        { 1, 2, 3, 8, 9, 10 }, {}, { SK_Q, SK_W, SK_E, SK_A, SK_S, SK_D, SK_Z, SK_X, SK_C },
+        { 1 << 0, 1 << 1, 1 << 2, 1 << 3, 1 << 4, 1 << 5, 1 << 6, 1 << 7, 1 << 8 } };
+    // mini
+    constexpr Model miniTouch = { KEYS_TOUCH, 2, 1, 0, 0,
+        { A0, A1 }, { 200, 175 }, { SK_Z, SK_X },
+        { 0x3 } };
+    // mega
+    constexpr Model megaTouch = { KEYS_TOUCH, 4, 1, 0, 0,
+        { A0, A1, A2, A3 }, { 175, 175, 150, 100 }, { SK_Z, SK_X, SK_ESC, SK_BKTK },
+        { 0xf } };
+    // 2x2 prototype, this should be changed to the xiao pins
+    constexpr Model touch2x2 = { KEYS_TOUCH, 4, 1, 0, 0,
+        { 7, 6, 0, 1 }, { 120, 120, 200, 150 }, { SK_Z, SK_X, SK_ESC, SK_BKTK },
+        { 0xf } };
+    // 6k
+    constexpr Model mini6k = { KEYS_TOUCH, 6, 1, 0, 0,
+        { A0, A1, A2, A3, A6, A7 }, { 170, 165, 130, 120, 110, 135 }, { SK_Q, SK_W, SK_E, SK_A, SK_S, SK_D },
+        { 0x3f } };
+    // mini xiao
+    constexpr Model miniXiao = { KEYS_TOUCH, 2, 2, 0, 0,
+        { 0, 1 }, { 220, 220 }, { SK_Z, SK_X },
+        { 1 << 0, 1 << 1 } };
+    // mega xiao
+    constexpr Model megaXiao = { KEYS_TOUCH, 4, 2, 0, 0,
+        { 0, 1, 7, 8 }, { 220, 220, 220, 220 }, { SK_Z, SK_X, SK_ESC, SK_BKTK },
+        { 1 << 0, 1 << 1 } };
+    // 4k mega xiao
+    constexpr Model mega4kXiao = { KEYS_TOUCH, 6, 4, 0, 0,
+        { 0, 1, 6, 7, 8, 9 }, { 220, 225, 190, 190, 190, 190 }, { SK_Z, SK_X, SK_C, SK_V, SK_ESC, SK_BKTK },
+        { 1 << 0, 1 << 1, 1 << 2, 1 << 3 } };
+}
+
+// The model this firmware is for
+static constexpr const Model &keypad = models::model;
+constexpr uint8_t numkeys = keypad.keys;
+constexpr uint8_t numleds = keypad.leds;
+constexpr uint8_t rows = keypad.rows;
+constexpr uint8_t cols = keypad.cols;
+
+static_assert(numkeys > 0 && numkeys <= MODEL_KEYS, "keys don't fit in keysDown");
+static_assert(numleds > 0 && numleds <= MODEL_LEDS, "no room for the LEDs");
+#if defined(TOUCH)
+static_assert(keypad.input == KEYS_TOUCH, "TOUCH builds need a touch model");
+#elif defined(MATRIX)
+static_assert(keypad.input == KEYS_MATRIX, "MATRIX builds need a matrix model");
+static_assert(numkeys == rows * cols, "keys has to be rows * cols");
+#else
+static_assert(keypad.input == KEYS_PINS, "touch and matrix models need TOUCH or MATRIX");
 #endif
 
-#ifdef TOUCH
-Adafruit_FreeTouch qt[numkeys];
+// Port group and bit of each pin, as in the board variant, so key masks are
+// constants instead of lookups in g_APinDescription
+struct PortPin {
+    uint8_t group;
+    uint8_t bit;
+};
+#ifdef ADAFRUIT_QTPY_M0
+constexpr PortPin boardPins[] = {
+    { 0, 2 }, { 0, 3 }, { 0, 4 }, { 0, 5 }, { 0, 16 },
+    { 0, 17 }, { 0, 6 }, { 0, 7 }, { 0, 11 }, { 0, 9 },
+    { 0, 10 }, { 0, 18 }, { 0, 15 }, { 0, 19 },
+};
+#else
+constexpr PortPin boardPins[] = {
+    { 0, 2 }, { 0, 4 }, { 0, 10 }, { 0, 11 }, { 0, 8 },
+    { 0, 9 }, { 1, 8 }, { 1, 9 }, { 0, 7 }, { 0, 5 },
+    { 0, 6 },
+};
 #endif
+constexpr uint8_t keyGroup(uint8_t x) { return boardPins[keypad.pins[x]].group; }
+constexpr uint32_t keyMask(uint8_t x) { return 1ul << boardPins[keypad.pins[x]].bit; }
+// EIC line of each key, the pin's bit within its port mod 16 (PA08 is the NMI)
+constexpr uint8_t keyLine(uint8_t x) { return boardPins[keypad.pins[x]].bit & 15; }
+constexpr bool keyNmi(uint8_t x) { return keyGroup(x) == 0 && boardPins[keypad.pins[x]].bit == 8; }
@@ -0,0 +1,75 @@
+// DMA NeoPixel output
+// Adafruit_NeoPixel::show() bit-bangs the strip with interrupts off, which
+// holds up key scans and USB for 30-40 us per LED. Where the data pin has a
+// SERCOM on PAD2, the frame is encoded for SPI (see ws2812.h) and a DMA
+// channel feeds it to the SERCOM, so starting a frame takes no time at all.
+// Other pins (neopin 0 is PA02, which has no SERCOM) keep using show().
+#pragma once
+
+#include <Arduino.h>
+#include <ws2812.h>
+
+#if defined(ADAFRUIT_QTPY_M0) && neopin == PIN_NEOPIXEL
+    // QT Py onboard LED on PA18, SERCOM3 PAD2 (SERCOM1 is Wire)
+    #define NEO_DMA
+    #define NEO_SERCOM SERCOM3
+    #define NEO_SERCOM_APB PM_APBCMASK_SERCOM3
+    #define NEO_SERCOM_GCLK SERCOM3_GCLK_ID_CORE
+    #define NEO_SERCOM_TX SERCOM3_DMAC_ID_TX
+#elif defined(XIAO) && neopin == 10
+    // XIAO D10 on PA06, SERCOM0 PAD2 (the SPI MOSI pin)
+    #define NEO_DMA
+    #define NEO_SERCOM SERCOM0
+    #define NEO_SERCOM_APB PM_APBCMASK_SERCOM0
+    #define NEO_SERCOM_GCLK SERCOM0_GCLK_ID_CORE
+    #define NEO_SERCOM_TX SERCOM0_DMAC_ID_TX
+#endif
+
+#ifdef NEO_DMA
+#include <wiring_private.h>
+
+// Channel 0 is the only one in use, so the tables hold one descriptor
+static DmacDescriptor neoDescriptor __attribute__((aligned(16)));
+static DmacDescriptor neoWriteback __attribute__((aligned(16)));
+
+inline void neoDmaBegin() {
+    pinPeripheral(neopin, PIO_SERCOM_ALT);
+    PM->APBCMASK.reg |= NEO_SERCOM_APB;
+    PM->AHBMASK.reg |= PM_AHBMASK_DMAC;
+    PM->APBBMASK.reg |= PM_APBBMASK_DMAC;
+    GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_ID(NEO_SERCOM_GCLK);
+    while (GCLK->STATUS.bit.SYNCBUSY);
+    // SPI master with data out on PAD2; SCK goes to PAD3 but isn't muxed out
+    NEO_SERCOM->SPI.CTRLA.reg = SERCOM_SPI_CTRLA_SWRST;
+    while (NEO_SERCOM->SPI.SYNCBUSY.bit.SWRST);
+    NEO_SERCOM->SPI.CTRLA.reg = SERCOM_SPI_CTRLA_MODE_SPI_MASTER | SERCOM_SPI_CTRLA_DOPO(1);
+    NEO_SERCOM->SPI.BAUD.reg = F_CPU / (2 * WS2812_SPI_HZ) - 1;
+    NEO_SERCOM->SPI.CTRLA.reg |= SERCOM_SPI_CTRLA_ENABLE;
+    while (NEO_SERCOM->SPI.SYNCBUSY.bit.ENABLE);
+    // One byte to the data register each time the SERCOM asks for one
+    DMAC->BASEADDR.reg = (uintptr_t)&neoDescriptor;
+    DMAC->WRBADDR.reg = (uintptr_t)&neoWriteback;
+    DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xf);
+    DMAC->CHID.reg = DMAC_CHID_ID(0);
+    DMAC->CHCTRLA.reg = 0;
+    DMAC->CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+    DMAC->CHCTRLB.reg = DMAC_CHCTRLB_TRIGSRC(NEO_SERCOM_TX) | DMAC_CHCTRLB_TRIGACT_BEAT;
+}
+
+// True until the last frame has gone out (the channel disables itself)
+inline bool neoDmaBusy() {
+    DMAC->CHID.reg = DMAC_CHID_ID(0);
+    return DMAC->CHCTRLA.reg & DMAC_CHCTRLA_ENABLE;
+}
+
+// Send an encoded frame; buf can't change until neoDmaBusy() is false
+inline void neoDmaStart(const uint8_t *buf, uint16_t len) {
+    neoDescriptor.BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE | DMAC_BTCTRL_SRCINC;
+    neoDescriptor.BTCNT.reg = len;
+    neoDescriptor.SRCADDR.reg = (uintptr_t)(buf + len); // End address when incrementing
+    neoDescriptor.DSTADDR.reg = (uintptr_t)&NEO_SERCOM->SPI.DATA.reg;
+    neoDescriptor.DESCADDR.reg = 0;
+    DMAC->CHID.reg = DMAC_CHID_ID(0);
+    DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
+}
+#endif
@@ -0,0 +1,76 @@
+// Low-power idle
+// Tiers, left all at once on the next key:
+//   POWER_ACTIVE   full scan rate, LEDs running
+//   POWER_IDLE     after idleMinutes: the LEDs fade out and stop updating,
+//                  and the core sleeps (WFI) between scans. Direct-pin models
+//                  also drop to the lowest scan rate and take the first press
+//                  from a pin change interrupt, which puts the rate back and
+//                  runs a scan straight away, so it's reported as fast as if
+//                  nothing had slowed down.
+//   POWER_SUSPEND  the USB host stopped sending frames: as above, with every
+//                  model at the lowest rate since nothing can be reported.
+// Touch and matrix models sleep too, but stay at the full rate in idle:
+// nothing wakes them early, so a slower rate would hold up the first press
+// by a whole slow sweep. While the core sleeps the pads are only collected
+// from the scan tick instead of as soon as each finishes, at most one tick
+// later.
+// Keys sharing an EIC line with one before them (or on the NMI) can't wake
+// the scan and are picked up by the slow scan instead.
+//
+// Time awake and asleep is counted so the duty cycle can be read back.
+#pragma once
+
+#include <Arduino.h>
+
+// No start of frame for this long is a suspended bus (ms)
+#define POWER_SUSPEND_MS 10
+
+enum { POWER_ACTIVE, POWER_IDLE, POWER_SUSPEND };
+
+struct PowerState {
+    uint8_t tier;
+    volatile bool slow;     // Scan rate is down and keys wake it back up
+    uint16_t frame;         // USB frame number last seen
+    unsigned long frameAt;  // When it last changed (ms)
+    unsigned long mark;     // End of the last sleep (us)
+    uint64_t awake;         // Time awake and asleep since the last read (us)
+    uint64_t asleep;
+    uint32_t sleeps;
+    uint32_t wakes;         // Pin change wake-ups
+};
+
+// Whether the host has stopped sending start of frame packets
+inline bool powerSuspended(PowerState &p, unsigned long now) {
+    uint16_t frame = USB->DEVICE.FNUM.bit.FNUM;
+    if (frame != p.frame) {
+        p.frame = frame;
+        p.frameAt = now;
+    }
+    return now - p.frameAt > POWER_SUSPEND_MS;
+}
+
+// Sleep until the next interrupt, counting the time on both sides
+inline void powerSleep(PowerState &p) {
+    unsigned long start = micros();
+    __WFI();
+    unsigned long end = micros();
+    p.awake += start - p.mark;
+    p.asleep += end - start;
+    p.mark = end;
+    p.sleeps++;
+}
+
+// Share of the time spent awake since the last clear, in tenths of a percent
+inline uint16_t powerDuty(PowerState &p) {
+    unsigned long now = micros();
+    p.awake += now - p.mark;
+    p.mark = now;
+    uint64_t total = p.awake + p.asleep;
+    return total ? p.awake * 1000 / total : 1000;
+}
+
+inline void powerClear(PowerState &p) {
+    p.mark = micros();
+    p.awake = p.asleep = 0;
+    p.sleeps = p.wakes = 0;
+}
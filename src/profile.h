@@ -0,0 +1,64 @@
+// Loop profiler
+// Times each stage of loop() (and the key scan in the timer interrupt)
+// with micros(), which comes from SysTick. Stages are timed back to back,
+// so each one costs a single micros() call. Each stage keeps its min, max,
+// total and a log2 histogram: bucket n counts times from 2^(n-1) to
+// 2^n - 1 us, bucket 0 is under 1 us and the last bucket takes everything
+// longer.
+//
+// It's always on so field units can be checked with "#prof" (protocol.h).
+#pragma once
+
+#include <Arduino.h>
+
+#define PROFILE_BUCKETS 16
+
+struct ProfileStage {
+    uint32_t count;
+    uint32_t total; // us
+    uint32_t min;
+    uint32_t max;
+    uint32_t hist[PROFILE_BUCKETS];
+};
+
+inline void profileReset(ProfileStage &s) {
+    s.count = 0;
+    s.total = 0;
+    s.min = 0xffffffff;
+    s.max = 0;
+    for (uint8_t x=0; x<PROFILE_BUCKETS; x++) s.hist[x] = 0;
+}
+
+inline uint8_t profileBucket(uint32_t us) {
+    uint8_t n = us ? 32 - __builtin_clz(us) : 0;
+    return n < PROFILE_BUCKETS ? n : PROFILE_BUCKETS - 1;
+}
+
+inline void profileRecord(ProfileStage &s, uint32_t us) {
+    s.count++;
+    s.total += us;
+    if (us < s.min) s.min = us;
+    if (us > s.max) s.max = us;
+    s.hist[profileBucket(us)]++;
+}
+
+// Time since the last mark goes to this stage
+inline void profileMark(ProfileStage &s, uint32_t &mark) {
+    uint32_t now = micros();
+    profileRecord(s, now - mark);
+    mark = now;
+}
+
+// Print " n= min= max= avg=" in us, then the histogram, ending the line
+inline void profilePrint(Print &out, const ProfileStage &s) {
+    out.print(F(" n=")); out.print(s.count);
+    out.print(F(" min=")); out.print(s.count ? s.min : 0);
+    out.print(F(" max=")); out.print(s.max);
+    out.print(F(" avg=")); out.print(s.count ? s.total / s.count : 0);
+    out.print(F(" hist="));
+    for (uint8_t x=0; x<PROFILE_BUCKETS; x++) {
+        if (x) out.print(',');
+        out.print(s.hist[x]);
+    }
+    out.println();
+}
@@ -0,0 +1,107 @@
+// Config protocol
+// Lines starting with '#' are for configurator software, everything else
+// still goes to the human menu. Characters are fed in as they arrive from
+// serialCheck(), so nothing waits on the host and keys keep working. The
+// human menu blocks instead: until it's closed no keys report and no '#'
+// lines are read, so configurators should stick to these.
+//
+//   #get                      -> #cfg keys=4 leds=2 bright=127 ... map=122,120,...
+//   #set bright=200 map=97,98 -> #cfg ... (applied and saved) or #err map
+//   #prof, #prof reset        -> #prof lines, one per loop stage (profile.h)
+//   #lat on, #lat off, #lat   -> #lat lines, press and release per key (latency.h)
+//   #cap on, #cap             -> #cap header, binary samples, #cap end (capture.h)
+//   #mem                      -> #mem static= heap= free= [capture=] in bytes (memory.h)
+//   #power                    -> #power tier= slow= duty= sleeps= wakes= (power.h)
+//   #scan                     -> #scan rate= ticks= min= max= late= since the last (scheduler.h)
+//   #bps, #bps reset          -> #bps all, then #bps lines per key (rate.h)
+//   #bps on, #bps off         -> #bps all every 100ms while keys are pressed
+//
+// A #set can carry any number of settings; they are all checked before any
+// are changed, so a bad value leaves everything as it was. Lists are
+// comma-separated with one value per key, except padded ones like the macro
+// table, which can stop early. A single value sets every key.
+#pragma once
+
+#include <Arduino.h>
+
+#define PROTOCOL_LINE 320 // Room for the macro table
+
+struct Setting {
+    const char *name;
+    uint8_t *value;
+    uint8_t count; // Values in the list
+    uint8_t min;
+    uint8_t max;
+    bool padded;   // A shorter list is filled out with zeros
+};
+
+struct LineReader {
+    char buf[PROTOCOL_LINE];
+    uint16_t len;
+    bool active;   // Inside a '#' line
+    bool overflow; // Line was too long and will be dropped
+};
+
+// Feed one character, returns true once a whole '#' line is in buf
+// (without the '#' and the line ending)
+inline bool lineFeed(LineReader &r, char c) {
+    if (!r.active) {
+        if (c == '#') { r.active = true; r.len = 0; r.overflow = false; }
+        return false;
+    }
+    if (c == '\r' || c == '\n') {
+        r.active = false;
+        r.buf[r.len] = 0;
+        return !r.overflow;
+    }
+    if (r.len < PROTOCOL_LINE - 1) r.buf[r.len++] = c;
+    else r.overflow = true;
+    return false;
+}
+
+inline void protocolPrint(Print &out, const Setting *settings, uint8_t count) {
+    for (uint8_t x=0; x<count; x++) {
+        out.print(' ');
+        out.print(settings[x].name);
+        out.print('=');
+        for (uint8_t y=0; y<settings[x].count; y++) {
+            if (y) out.print(',');
+            out.print(settings[x].value[y]);
+        }
+    }
+}
+
+// Parse "name=v,v,... name=v" and, if everything is valid and apply is set,
+// store it. Returns the setting that failed, or -1.
+inline int8_t protocolParse(char *args, const Setting *settings, uint8_t count, bool apply) {
+    char *p = args;
+    while (*p) {
+        while (*p == ' ') p++;
+        if (!*p) break;
+        char *name = p;
+        while (*p && *p != '=' && *p != ' ') p++;
+        if (*p != '=') return count;
+        *p = 0;
+        int8_t s = -1;
+        for (uint8_t x=0; x<count; x++) if (!strcmp(name, settings[x].name)) s = x;
+        *p++ = '=';
+        if (s < 0) return count;
+        uint8_t given = 0;
+        for (uint8_t y=0; y<settings[s].count; y++) {
+            if (y && (!*p || *p == ' ')) {
+                if (given > 1 && !settings[s].padded) return s;
+                if (apply) settings[s].value[y] = settings[s].padded ? 0 : settings[s].value[0];
+                continue;
+            }
+            if (y && *p++ != ',') return s;
+            if (!isDigit(*p)) return s;
+            uint16_t v = 0;
+            while (isDigit(*p) && v <= 255) v = v * 10 + (*p++ - '0');
+            if (v < settings[s].min || v > settings[s].max) return s;
+            if (apply) settings[s].value[y] = v;
+            given++;
+        }
+        if (*p && *p != ' ') return s;
+    }
+    return -1;
+}
@@ -0,0 +1,50 @@
+// Non-blocking touch measurement
+// The PTC converts one pad at a time. Instead of waiting on each one like
+// Adafruit_FreeTouch::measure() does, the scan tick checks whether the
+// current conversion is done, starts the next pad straight away, and only
+// then hands back the finished result, so the PTC keeps converting while
+// the result is processed.
+//
+// qt[x].begin() still does the clock and pin setup; the conversions use the
+// same driver underneath with one config per pad.
+#pragma once
+
+#include <Arduino.h>
+#include <Adafruit_FreeTouch.h>
+
+struct PtcScanner {
+    adafruit_ptc_config config[numkeys];
+    uint8_t pad; // Pad being converted
+};
+
+// Y line of a pin (PA02-PA07 are Y0-Y5, PB00-PB09 are Y6-Y15), -1 if none
+inline int8_t ptcYLine(uint8_t pin) {
+    uint32_t p = g_APinDescription[pin].ulPin;
+    if (g_APinDescription[pin].ulPort == PORTA) return (p >= 2 && p <= 7) ? p - 2 : -1;
+    return p <= 9 ? p + 6 : -1;
+}
+
+// Set up every pad and start converting the first one
+inline void ptcBegin(PtcScanner &s, const uint8_t *pins, oversample_t oversample, series_resistor_t resistor) {
+    for (uint8_t x=0; x<numkeys; x++) {
+        adafruit_ptc_get_config_default(&s.config[x]);
+        s.config[x].pin = pins[x];
+        s.config[x].yline = ptcYLine(pins[x]);
+        s.config[x].oversample = oversample;
+        s.config[x].seriesres = resistor;
+        s.config[x].freqhop = FREQ_MODE_NONE;
+    }
+    s.pad = 0;
+    adafruit_ptc_start_conversion((Ptc *)PTC, &s.config[0]);
+}
+
+// Returns the pad that just finished and its value (scaled like measure()),
+// or -1 if the conversion is still running
+inline int8_t ptcPoll(PtcScanner &s, uint16_t &value) {
+    if (!adafruit_ptc_is_conversion_finished((Ptc *)PTC)) return -1;
+    uint8_t done = s.pad;
+    value = adafruit_ptc_get_conversion_result((Ptc *)PTC) >> s.config[done].oversample;
+    s.pad = (done + 1) % numkeys;
+    adafruit_ptc_start_conversion((Ptc *)PTC, &s.config[s.pad]);
+    return done;
+}
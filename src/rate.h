@@ -0,0 +1,109 @@
+// Keystroke rate
+// Every press goes into a ring with its time. Rates are read back over a
+// sliding window from the intervals between the presses in it, so they
+// follow the tapping pace within a couple of presses instead of waiting for
+// a count to fill up. Once the gap since the last press is longer than that
+// pace it counts as an interval too, and the rate falls away smoothly when
+// tapping stops. Presses in the same ms (a chord) are one stroke, so only
+// strokes are timed. More than RATE_RING presses in a window just makes the
+// window shorter.
+//
+// The unstable rate is the spread of the same intervals, ten times their
+// standard deviation in ms as rhythm games show it. Lower is steadier.
+#pragma once
+
+#include <Arduino.h>
+
+#define RATE_RING 64
+#define RATE_WINDOW_MS 1000
+// Strokes are never read as closer together than this over the window
+// (ms), or two a few ms apart would be hundreds a second
+#define RATE_MIN_SPAN_MS 100
+#define RATE_MAX_KEYS 32
+
+struct RateMeter {
+    unsigned long at[RATE_RING]; // Press times (ms)
+    uint8_t key[RATE_RING];
+    uint8_t head;                // Next slot
+    uint8_t used;                // Slots filled
+    uint16_t peak;               // Highest rate of all keys together since the last clear
+    uint16_t keyPeak[RATE_MAX_KEYS];
+    uint32_t presses[RATE_MAX_KEYS];
+};
+
+struct Rate {
+    uint16_t rate;     // Strokes a second, in tenths
+    uint16_t unstable; // Ten times the standard deviation of the intervals (ms)
+    uint8_t presses;   // In the window
+    uint8_t strokes;
+};
+
+inline uint16_t rateSqrt(uint32_t x) {
+    uint32_t r = 0, bit = 1ul << 30;
+    while (bit > x) bit >>= 2;
+    while (bit) {
+        if (x >= r + bit) { x -= r + bit; r = (r >> 1) + bit; }
+        else r >>= 1;
+        bit >>= 2;
+    }
+    return r;
+}
+
+// Rate of the presses on any of keys in the window up to now
+inline Rate rateRead(const RateMeter &m, unsigned long now, uint32_t keys) {
+    Rate r = {};
+    unsigned long newest = 0, oldest = 0;
+    uint32_t sum = 0;
+    uint64_t squares = 0;
+    for (uint8_t n = 0; n < m.used; n++) {
+        uint8_t i = (m.head + RATE_RING - 1 - n) % RATE_RING;
+        if (now - m.at[i] > RATE_WINDOW_MS) break;
+        if (!((keys >> m.key[i]) & 1)) continue;
+        r.presses++;
+        if (r.strokes && m.at[i] == oldest) continue;
+        if (r.strokes) {
+            uint32_t interval = oldest - m.at[i];
+            sum += interval;
+            squares += (uint64_t)interval * interval;
+        }
+        else newest = m.at[i];
+        oldest = m.at[i];
+        r.strokes++;
+    }
+    if (r.strokes < 2) {
+        r.rate = r.strokes * 10000ul / RATE_WINDOW_MS;
+        return r;
+    }
+    uint8_t intervals = r.strokes - 1;
+    uint32_t span = newest - oldest;
+    if (span < RATE_MIN_SPAN_MS) span = RATE_MIN_SPAN_MS;
+    // Slower than the pace so far, so the gap is an interval too
+    uint32_t since = now - oldest;
+    if ((now - newest) * intervals > span) r.rate = r.strokes * 10000ul / (since > span ? since : span);
+    else r.rate = intervals * 10000ul / span;
+    if (intervals > 1) {
+        uint64_t variance = (squares - (uint64_t)sum * sum / intervals) / intervals;
+        r.unstable = rateSqrt(variance * 100 < UINT32_MAX ? variance * 100 : UINT32_MAX);
+    }
+    return r;
+}
+
+// Stamp a press and keep the peaks up to date
+inline void rateStamp(RateMeter &m, uint8_t key, unsigned long now) {
+    m.at[m.head] = now;
+    m.key[m.head] = key;
+    m.head = (m.head + 1) % RATE_RING;
+    if (m.used < RATE_RING) m.used++;
+    m.presses[key]++;
+    uint16_t all = rateRead(m, now, 0xffffffff).rate;
+    uint16_t one = rateRead(m, now, 1ul << key).rate;
+    if (all > m.peak) m.peak = all;
+    if (one > m.keyPeak[key]) m.keyPeak[key] = one;
+}
+
+// Start the peaks and totals over, the window carries on
+inline void rateClear(RateMeter &m) {
+    m.peak = 0;
+    memset(m.keyPeak, 0, sizeof(m.keyPeak));
+    memset(m.presses, 0, sizeof(m.presses));
+}
@@ -0,0 +1,57 @@
+// Fixed-rate scan scheduler
+// TC3 interrupts at scanRate kHz and the handler in main.cpp runs the key
+// scan, so scan timing doesn't depend on how long LEDs or the console take
+// in loop(). Every tick is timestamped to keep track of jitter, which
+// "#scan" reads back.
+#pragma once
+
+#include <Arduino.h>
+
+#define SCAN_RATE_MIN 1 // kHz
+#define SCAN_RATE_MAX 8
+
+struct ScanStats {
+    uint32_t ticks;
+    unsigned long last;      // When the last tick ran (us)
+    unsigned long minPeriod; // Shortest and longest gap between ticks (us)
+    unsigned long maxPeriod;
+    uint32_t late;           // Ticks more than a quarter period late
+};
+
+// Start TC3 on the 48 MHz GCLK0; safe to call again to change the rate
+inline void scanTimerBegin(uint8_t kHz) {
+    GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_ID_TCC2_TC3;
+    while (GCLK->STATUS.bit.SYNCBUSY);
+    TC3->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+    while (TC3->COUNT16.STATUS.bit.SYNCBUSY);
+    TC3->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_WAVEGEN_MFRQ | TC_CTRLA_PRESCALER_DIV1;
+    while (TC3->COUNT16.STATUS.bit.SYNCBUSY);
+    TC3->COUNT16.CC[0].reg = F_CPU / (kHz * 1000ul) - 1;
+    while (TC3->COUNT16.STATUS.bit.SYNCBUSY);
+    TC3->COUNT16.INTENSET.reg = TC_INTENSET_MC0;
+    NVIC_SetPriority(TC3_IRQn, 1);
+    NVIC_EnableIRQ(TC3_IRQn);
+    TC3->COUNT16.CTRLA.reg |= TC_CTRLA_ENABLE;
+    while (TC3->COUNT16.STATUS.bit.SYNCBUSY);
+}
+
+// Call first thing in the handler
+inline void scanRecord(volatile ScanStats &s, unsigned long now, uint8_t kHz) {
+    if (s.ticks) {
+        unsigned long period = now - s.last;
+        unsigned long nominal = 1000 / kHz;
+        if (period < s.minPeriod) s.minPeriod = period;
+        if (period > s.maxPeriod) s.maxPeriod = period;
+        if (period > nominal + nominal / 4) s.late++;
+    }
+    s.last = now;
+    s.ticks++;
+}
+
+// Start a new measurement window
+inline void scanReset(volatile ScanStats &s) {
+    s.ticks = 0;
+    s.minPeriod = 0xffffffff;
+    s.maxPeriod = 0;
+    s.late = 0;
+}
@@ -0,0 +1,112 @@
+// Settings log
+// Settings live in RAM and are saved as records appended to a few rows of
+// flash. Each record is a header and the settings struct, padded to whole
+// pages, with a CRC over both. Loading takes the valid record with the
+// highest sequence number, so a save cut short by power loss just leaves
+// the one before it in charge.
+//
+// Rows are used in turn. Moving into a row erases it first; that row only
+// holds records older than the latest one, so the log never has to be
+// copied or compacted, and a row is only erased once every few saves
+// instead of on every save.
+#pragma once
+
+#include <Arduino.h>
+#include <FlashStorage.h>
+
+#define LOG_PAGE 64
+#define LOG_ROW 256
+#define LOG_ROWS 8
+#define LOG_MAGIC 0x5367
+
+struct LogHeader {
+    uint16_t magic;
+    uint8_t version; // Layout of the settings struct
+    uint8_t length;  // Bytes of settings after the header
+    uint32_t sequence;
+    uint32_t crc;    // Over the header up to here and the settings
+};
+
+__attribute__((__aligned__(LOG_ROW)))
+static const uint8_t logFlash[LOG_ROW * LOG_ROWS] = { };
+static FlashClass logStore(logFlash, sizeof(logFlash));
+
+struct SettingsLog {
+    uint16_t slotSize; // Record size rounded up to pages
+    uint16_t next;     // Offset the next save goes to
+    uint32_t sequence; // Sequence of the latest record
+};
+
+inline uint32_t crc32(uint32_t crc, const uint8_t *data, uint16_t length) {
+    crc = ~crc;
+    while (length--) {
+        crc ^= *data++;
+        for (uint8_t x=0; x<8; x++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+inline uint32_t logCrc(const LogHeader &h, const uint8_t *data) {
+    return crc32(crc32(0, (const uint8_t *)&h, offsetof(LogHeader, crc)), data, h.length);
+}
+
+inline uint16_t logPages(uint16_t bytes) { return (bytes + LOG_PAGE - 1) / LOG_PAGE * LOG_PAGE; }
+
+// Find the latest record and copy it into data. Returns its version, or 0
+// if there isn't one. A record shorter than size (saved before fields were
+// added) only fills the start of data, so the rest keeps its defaults.
+// Every page is checked, so records saved at another size are found too.
+inline uint8_t logLoad(SettingsLog &log, void *data, uint8_t size) {
+    log.slotSize = logPages(sizeof(LogHeader) + size);
+    uint8_t record[LOG_ROW];
+    int16_t best = -1;
+    uint8_t version = 0;
+    for (uint16_t at=0; at<sizeof(logFlash); at+=LOG_PAGE) {
+        LogHeader h;
+        logStore.read(logFlash + at, &h, sizeof(h));
+        if (h.magic != LOG_MAGIC || at % LOG_ROW + sizeof(h) + h.length > LOG_ROW) continue;
+        if (best >= 0 && (int32_t)(h.sequence - log.sequence) <= 0) continue;
+        logStore.read(logFlash + at, record, sizeof(h) + h.length);
+        if (logCrc(h, record + sizeof(h)) != h.crc) continue;
+        memcpy(data, record + sizeof(h), h.length < size ? h.length : size);
+        best = at;
+        version = h.version;
+        log.sequence = h.sequence;
+        log.next = (at + logPages(sizeof(h) + h.length)) % sizeof(logFlash);
+    }
+    if (best < 0) {
+        log.sequence = 0;
+        log.next = 0;
+    }
+    return version;
+}
+
+inline bool logBlank(uint16_t at, uint16_t bytes) {
+    uint8_t record[LOG_ROW];
+    logStore.read(logFlash + at, record, bytes);
+    for (uint16_t x=0; x<bytes; x++) if (record[x] != 0xff) return false;
+    return true;
+}
+
+// Append a record, erasing the row ahead when the log moves into it
+inline void logSave(SettingsLog &log, uint8_t version, const void *data, uint8_t size) {
+    uint16_t inRow = log.next % LOG_ROW;
+    // Go on to the next row if the record doesn't fit, or a save cut short
+    // left something behind
+    if (inRow && (inRow + log.slotSize > LOG_ROW || !logBlank(log.next, log.slotSize)))
+        log.next = (log.next - inRow + LOG_ROW) % sizeof(logFlash);
+    if (log.next % LOG_ROW == 0) logStore.erase(logFlash + log.next, LOG_ROW);
+    uint8_t record[LOG_ROW];
+    memset(record, 0xff, log.slotSize);
+    LogHeader h;
+    h.magic = LOG_MAGIC;
+    h.version = version;
+    h.length = size;
+    h.sequence = log.sequence + 1;
+    memcpy(record + sizeof(h), data, size);
+    h.crc = logCrc(h, record + sizeof(h));
+    memcpy(record, &h, sizeof(h));
+    logStore.write(logFlash + log.next, record, log.slotSize);
+    log.sequence = h.sequence;
+    log.next = (log.next + log.slotSize) % sizeof(logFlash);
+}
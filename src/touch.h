@@ -0,0 +1,119 @@
+// Touch press detection
+// Each pad tracks its resting value with a slow IIR filter that only runs
+// while the pad is released, so drift from temperature, humidity and grip
+// doesn't need a recalibration. A press is the value rising more than
+// delta above that baseline, and the release point is resetValue below it.
+//
+// Thresholds stay absolute in the menus and EEPROM; touchCapture() turns
+// one into a delta against the baseline at the time it's set.
+//
+// The rapid modes treat the value as a continuous signal instead, so taps
+// don't have to cross back through the release point. Once pressed, a pad
+// releases as soon as the value falls back by its rapid delta from the
+// highest point, and presses again once it rises by the same delta from
+// the lowest point since. Dropping to within resetValue of the baseline
+// puts it back at rest, and so does staying released below the press point
+// for TOUCH_REST_SAMPLES, since the baseline is held while the pad is
+// active and a rest level that crept up past the release point would
+// otherwise read as presses. TOUCH_SLOPE also takes the first press from
+// rest on a fast rise instead of waiting for the threshold.
+#pragma once
+
+#include <Arduino.h>
+
+// Each released sample moves the baseline 1/1024 of the way to it
+#define TOUCH_BASELINE_SHIFT 10
+// The slope is measured against a trail that moves 1/4 of the way to each
+// sample, so a slow drift never gets far enough ahead of it
+#define TOUCH_TRAIL_SHIFT 2
+// Released samples below the press point that put a rapid pad back at rest
+#define TOUCH_REST_SAMPLES 1024
+
+// Press modes, set per pad
+enum { TOUCH_LEVEL, TOUCH_RAPID, TOUCH_SLOPE, TOUCH_MODES };
+
+struct TouchPad {
+    int32_t baseline;  // Resting value, 16.16 fixed point
+    uint8_t threshold; // Absolute threshold the delta was taken from
+    uint8_t delta;     // Press point above the baseline
+    bool seeded;       // Baseline has had a sample
+    uint8_t mode;      // TOUCH_LEVEL, TOUCH_RAPID or TOUCH_SLOPE
+    uint8_t rapid;     // Reversal that releases or presses again, rapid modes
+    uint8_t turn;      // Highest value while held, lowest while released
+    bool active;       // Pressed since the pad was last at rest
+    int16_t trail;     // Recent values, 8.4 fixed point
+    uint16_t resting;  // Released samples below delta while active
+};
+
+inline uint8_t touchBaseline(const TouchPad &p) { return p.baseline >> 16; }
+
+// Scale a 10 bit PTC result to the byte thresholds are set in
+inline uint8_t touchValue(uint16_t raw) { return raw / 4; }
+
+// Take the delta from an absolute threshold, keeping the release point
+// above the baseline
+inline void touchCapture(TouchPad &p, uint8_t threshold, uint8_t resetValue) {
+    p.threshold = threshold;
+    if (!p.seeded) return;
+    int16_t delta = threshold - touchBaseline(p);
+    if (delta <= resetValue) delta = resetValue + 1;
+    p.delta = delta > 255 ? 255 : delta;
+}
+
+// Pick the press mode and the delta for the rapid modes
+inline void touchMode(TouchPad &p, uint8_t mode, uint8_t rapid) {
+    p.mode = mode < TOUCH_MODES ? mode : (uint8_t)TOUCH_LEVEL;
+    p.rapid = rapid ? rapid : 1;
+    p.active = false;
+}
+
+// Rapid modes, see the top of the file
+inline bool touchRapid(TouchPad &p, uint8_t value, int16_t above, int16_t slope, bool down, uint8_t resetValue) {
+    if (above <= resetValue) {
+        p.active = false;
+        return false;
+    }
+    if (!p.active) {
+        bool rising = p.mode == TOUCH_SLOPE && slope >= p.rapid;
+        if (above <= p.delta && !rising) return false;
+        p.active = true;
+        p.turn = value;
+        p.resting = 0;
+        return true;
+    }
+    if (down) {
+        p.resting = 0;
+        if (value > p.turn) p.turn = value;
+        else if (p.turn - value >= p.rapid) { p.turn = value; return false; }
+        return true;
+    }
+    if (above > p.delta) p.resting = 0;
+    else if (++p.resting >= TOUCH_REST_SAMPLES) {
+        p.active = false;
+        return false;
+    }
+    if (value < p.turn) p.turn = value;
+    else if (value - p.turn >= p.rapid) { p.turn = value; p.resting = 0; return true; }
+    return false;
+}
+
+// Feed one sample, returns whether the pad is held
+inline bool touchUpdate(TouchPad &p, uint8_t value, bool down, uint8_t resetValue) {
+    if (!p.seeded) {
+        // Don't let a pad touched at power-on start out held
+        uint8_t rest = p.threshold > resetValue ? p.threshold - resetValue : 0;
+        p.baseline = (int32_t)(value < rest ? value : rest) << 16;
+        p.seeded = true;
+        p.trail = value << 4;
+        touchCapture(p, p.threshold, resetValue);
+    }
+    int16_t above = value - touchBaseline(p);
+    int16_t slope = value - (p.trail >> 4);
+    p.trail += ((value << 4) - p.trail) >> TOUCH_TRAIL_SHIFT;
+    if (p.mode != TOUCH_LEVEL) down = touchRapid(p, value, above, slope, down, resetValue);
+    else if (above > p.delta) down = true;
+    else if (above < p.delta - resetValue) down = false;
+    // The baseline only follows a pad at rest
+    if (!down && !p.active) p.baseline += (((int32_t)value << 16) - p.baseline) >> TOUCH_BASELINE_SHIFT;
+    return down;
+}
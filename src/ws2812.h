@@ -0,0 +1,36 @@
+// WS2812 frame encoding for SPI output
+// At 2.4 MHz three SPI bits last one WS2812 bit (1.25 us), so every data bit
+// goes out as 110 for a 1 or 100 for a 0 and each LED byte becomes three
+// SPI bytes. The frame starts with a low byte so the line is idle before
+// the first bit, and ends low for long enough to latch.
+//
+// No Arduino dependencies so the encoder can be tested on the host.
+#pragma once
+
+#include <stdint.h>
+
+#define WS2812_SPI_HZ 2400000
+#define WS2812_LEAD_BYTES 1
+#define WS2812_LATCH_BYTES 90 // 300 us
+#define WS2812_ENCODED_SIZE(bytes) (WS2812_LEAD_BYTES + (bytes) * 3 + WS2812_LATCH_BYTES)
+
+// SPI bits for each nibble, MSB first
+const uint16_t ws2812Nibble[16] = {
+    0x924, 0x926, 0x934, 0x936, 0x9a4, 0x9a6, 0x9b4, 0x9b6,
+    0xd24, 0xd26, 0xd34, 0xd36, 0xda4, 0xda6, 0xdb4, 0xdb6
+};
+
+// Encode bytes (in wire order) into out, which has to hold
+// WS2812_ENCODED_SIZE(bytes). Returns the encoded length.
+inline uint16_t ws2812Encode(const uint8_t *in, uint16_t bytes, uint8_t *out) {
+    uint8_t *o = out;
+    for (uint8_t x=0; x<WS2812_LEAD_BYTES; x++) *o++ = 0;
+    for (uint16_t x=0; x<bytes; x++) {
+        uint32_t bits = ((uint32_t)ws2812Nibble[in[x] >> 4] << 12) | ws2812Nibble[in[x] & 0xf];
+        *o++ = bits >> 16;
+        *o++ = bits >> 8;
+        *o++ = bits;
+    }
+    for (uint8_t x=0; x<WS2812_LATCH_BYTES; x++) *o++ = 0;
+    return o - out;
+}
@@ -0,0 +1,519 @@
+// Input scenarios through the scan and report path, run with `make test`.
+// Each scenario scripts what the switches or pads do over time, plays it
+// through setup()/loop() on the shim's clock and scores the HID reports
+// that reach the host: presses missed or made up, keys left stuck, and the
+// press latency and its jitter (max - min). Scripts are built from a fixed
+// hash so every run sees the same chatter and noise.
+#include <unity.h>
+#include <Arduino.h>
+#include <hal_native.h>
+#include <models.h>
+#include <keycodes.h>
+#include <touch.h>
+#include <stdio.h>
+#include <vector>
+
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+void setup();
+void loop();
+
+// Keys are mapped to F13 and up so each one has its own usage
+static_assert(numkeys <= 12, "one F13-F24 usage per key");
+static const uint8_t firstCode = 149;
+
+// Virtual time between loop() calls, roughly one pass on hardware
+static const uint32_t stepMicros = 50;
+// Debounce window the contact scenarios run with (ms)
+static const uint8_t debounceMs = 4;
+
+// Contact made and broken, in us from the start of the scenario. Strokes
+// that aren't expected are glitches the firmware has to ignore.
+struct Stroke {
+    uint8_t key;
+    uint32_t start, end;
+    bool expect;
+};
+
+struct Score {
+    uint32_t expected, presses, missed, phantom, stuck;
+    int32_t latMin, latMax, latSum; // Negative for a press ahead of the stroke
+    uint32_t jitter() const { return expected > missed ? latMax - latMin : 0; }
+};
+
+static std::vector<Stroke> strokes;
+static uint32_t bounceMicros;
+
+static void stroke(uint8_t key, uint32_t start, uint32_t end, bool expect = true) {
+    strokes.push_back({ key, start, end, expect });
+}
+
+static uint32_t hash(uint32_t x) {
+    x ^= x >> 16; x *= 0x7feb352d;
+    x ^= x >> 15; x *= 0x846ca68b;
+    return x ^ (x >> 16);
+}
+
+static std::string command(const char *line, const char *expect = "#cfg") {
+    hal::serialInput(line);
+    for (uint8_t i = 0; i < 200; i++) { hal::advance(stepMicros); loop(); }
+    std::string reply = hal::serialOutput();
+    TEST_ASSERT_TRUE_MESSAGE(reply.find(expect) != std::string::npos, line);
+    return reply;
+}
+
+// "name=v,v+step,..." with one value per key
+static std::string perKey(const char *name, unsigned value, unsigned step = 0) {
+    std::string s = name;
+    for (uint8_t x = 0; x < numkeys; x++) {
+        s += x ? "," : "=";
+        s += std::to_string(value + x * step);
+    }
+    return s;
+}
+
+#ifdef TOUCH
+// Pads rest at touchRest and a finger adds touchPeak - touchRest, with
+// thresholds set touchDelta above the rest. Values are 10 bit raw counts,
+// four to each threshold step.
+static const uint16_t touchRest = 400, touchPeak = 1000, touchDelta = 320;
+// Time a finger takes to land or lift (us)
+static const uint32_t touchRamp = 3000;
+// The ramp starts this far ahead of the stroke, and noise can push it over
+// the threshold anywhere in there
+static const uint32_t earlyMicros = touchRamp * touchDelta / (touchPeak - touchRest);
+static uint16_t touchNoise;    // Peak noise either way
+static uint16_t touchDrift;    // Rest rises this far by halfway and falls back
+static uint32_t touchLength;   // Length of the scenario, for the drift
+
+static uint16_t restLevel() { return touchRest; }
+
+// Strokes start where the clean curve crosses the threshold, so the ramp
+// begins a little earlier
+static uint16_t level(uint8_t x, uint32_t t) {
+    int32_t rest = touchRest;
+    if (touchDrift && t < touchLength) {
+        uint32_t half = touchLength / 2;
+        rest += (uint64_t)touchDrift * (t < half ? t : touchLength - t) / half;
+    }
+    int32_t v = rest;
+    for (const Stroke &s : strokes) {
+        if (s.key != x || t + earlyMicros < s.start || t >= s.end + touchRamp) continue;
+        uint32_t begin = s.start - earlyMicros;
+        int32_t rise = touchPeak - touchRest;
+        if (t < begin + touchRamp) v += rise * (t - begin) / touchRamp;
+        else if (t < s.end) v += rise;
+        else v += rise * (s.end + touchRamp - t) / touchRamp;
+        break;
+    }
+    if (touchNoise) v += (int32_t)(hash(t / 100 * 16 + x) % (2 * touchNoise + 1)) - touchNoise;
+    return v < 0 ? 0 : v > 1023 ? 1023 : v;
+}
+
+static void drive(uint8_t x, uint16_t v) { hal::setTouch(keypad.pins[x], v); }
+#else
+static const uint32_t earlyMicros = 0;
+
+static uint16_t restLevel() { return 0; }
+
+// A switch is closed through each stroke and chatters for bounceMicros
+// after making and breaking contact, starting with the new level
+static uint16_t level(uint8_t x, uint32_t t) {
+    for (const Stroke &s : strokes) {
+        if (s.key != x || t < s.start || t >= s.end + bounceMicros) continue;
+        if (t >= s.end) return t - s.end < 100 ? 0 : hash(t / 100 * 16 + x) & 1;
+        if (t < s.start + bounceMicros) return t - s.start < 100 ? 1 : hash(t / 100 * 16 + x) & 1;
+        return 1;
+    }
+    return 0;
+}
+
+#ifdef MATRIX
+static void drive(uint8_t x, uint16_t closed) {
+    hal::setSwitch(keypad.pins[x / cols], keypad.pins[rows + x % cols], closed);
+}
+#else
+static void drive(uint8_t x, uint16_t closed) { hal::setPin(keypad.pins[x], !closed); }
+#endif
+#endif
+
+// Match reported presses to strokes in order, per key. A press counts for
+// the first expected stroke it lands in; anything else is a phantom.
+static Score score(const char *name, uint32_t t0) {
+    std::vector<uint32_t> presses[numkeys];
+    bool down[numkeys] = {};
+    for (const hal::Report &r : hal::reports()) {
+        if (r.device != hal::DEVICE_KEYBOARD) continue;
+        for (uint8_t x = 0; x < numkeys; x++) {
+            bool d = r.key(KEY_F13 + x);
+            if (d && !down[x]) presses[x].push_back(r.micros - t0);
+            down[x] = d;
+        }
+    }
+    Score s = {};
+    s.latMin = INT32_MAX;
+    size_t next[numkeys] = {};
+    uint32_t matched = 0;
+    for (const Stroke &st : strokes) {
+        if (!st.expect) continue;
+        const std::vector<uint32_t> &p = presses[st.key];
+        size_t &i = next[st.key];
+        s.expected++;
+        while (i < p.size() && p[i] + earlyMicros < st.start) i++;
+        if (i < p.size() && p[i] < st.end) {
+            int32_t lat = p[i++] - st.start;
+            if (lat < s.latMin) s.latMin = lat;
+            if (lat > s.latMax) s.latMax = lat;
+            s.latSum += lat;
+            matched++;
+        }
+        else s.missed++;
+    }
+    for (uint8_t x = 0; x < numkeys; x++) {
+        s.presses += presses[x].size();
+        s.stuck += down[x];
+    }
+    s.phantom = s.presses - matched;
+    if (!matched) s.latMin = 0;
+    printf("%-14s %-16s %4u/%-4u pressed  missed %u  phantom %u  stuck %u  latency %5d min %5d avg %5d max  jitter %5u us\n",
+            XSTR(MODEL), name, matched, s.expected, s.missed, s.phantom, s.stuck,
+            s.latMin, matched ? s.latSum / (int32_t)matched : 0, s.latMax, s.jitter());
+    return s;
+}
+
+// Play the strokes for length us plus time to settle, then score them
+static Score play(const char *name, uint32_t length) {
+#ifdef TOUCH
+    touchLength = length;
+#endif
+    uint64_t t0 = hal::now();
+    hal::clearReports();
+    // loop() can take time of its own (sleeping, flash), so go by the clock
+    for (uint32_t t = 0; t < length + 50000; t = hal::now() - t0) {
+        for (uint8_t x = 0; x < numkeys; x++) drive(x, level(x, t));
+        hal::advance(stepMicros);
+        loop();
+    }
+    Score s = score(name, (uint32_t)t0);
+    strokes.clear();
+    return s;
+}
+
+static void assertClean(const Score &s) {
+    TEST_ASSERT_EQUAL_UINT32(0, s.missed);
+    TEST_ASSERT_EQUAL_UINT32(0, s.phantom);
+    TEST_ASSERT_EQUAL_UINT32(0, s.stuck);
+}
+
+// The firmware keeps running from one scenario to the next, the way it
+// would on a desk, so its clock and state carry over. Each one starts with
+// every key released and its own settings.
+void setUp() {
+    for (uint8_t x = 0; x < numkeys; x++) drive(x, restLevel());
+    // Let debouncing finish, and on touch models the baselines settle on
+    // the rest level before the deltas are taken
+    for (uint32_t t = 0; t < 500000; t += stepMicros) { hal::advance(stepMicros); loop(); }
+    std::string line = "#set " + perKey("map", firstCode, 1);
+#ifdef TOUCH
+    line += " " + perKey("thresh", (touchRest + touchDelta) / 4) + " " + perKey("tmode", TOUCH_LEVEL) + " reset=12";
+#else
+    line += " dbmode=0 debounce=" + std::to_string(debounceMs);
+#endif
+    command((line + "\n").c_str());
+    bounceMicros = 0;
+#ifdef TOUCH
+    touchNoise = touchDrift = 0;
+#endif
+}
+
+void tearDown() { strokes.clear(); }
+
+#ifndef TOUCH
+// Worst case from first contact to report: chatter, the window, a scan
+// and a loop
+static int32_t contactBound() { return bounceMicros + debounceMs * 1000 + 2000; }
+
+// Reports that pressed n keys at once
+static uint32_t together(uint8_t n) {
+    uint32_t count = 0;
+    bool down[numkeys] = {};
+    for (const hal::Report &r : hal::reports()) {
+        if (r.device != hal::DEVICE_KEYBOARD) continue;
+        uint8_t pressed = 0;
+        for (uint8_t x = 0; x < numkeys; x++) {
+            bool d = r.key(KEY_F13 + x);
+            pressed += d && !down[x];
+            down[x] = d;
+        }
+        count += pressed == n;
+    }
+    return count;
+}
+
+// Each key in turn through 10 presses that chatter for 1ms on both edges. Stable
+// debounce reports once the contact has been still for the window.
+void test_chatter() {
+    bounceMicros = 1000;
+    for (uint8_t x = 0; x < numkeys; x++)
+        for (uint32_t n = 0; n < 10; n++) stroke(x, x * 800000 + n * 80000, x * 800000 + n * 80000 + 40000);
+    Score s = play("chatter", numkeys * 800000);
+    assertClean(s);
+    TEST_ASSERT_LESS_OR_EQUAL(contactBound(), s.latMax);
+}
+
+// The same in eager mode, which reports the first edge straight away
+void test_chatter_eager() {
+    command("#set dbmode=1\n");
+    bounceMicros = 1000;
+    for (uint8_t x = 0; x < numkeys; x++)
+        for (uint32_t n = 0; n < 10; n++) stroke(x, x * 800000 + n * 80000, x * 800000 + n * 80000 + 40000);
+    Score s = play("chatter eager", numkeys * 800000);
+    assertClean(s);
+    TEST_ASSERT_LESS_OR_EQUAL(2000, s.latMax);
+}
+
+// Contact blips shorter than the window are never reported
+void test_glitches() {
+    for (uint8_t x = 0; x < numkeys; x++)
+        for (uint32_t n = 0; n < 20; n++) stroke(x, n * 10000 + x * 500, n * 10000 + x * 500 + 200 + n * 50, false);
+    assertClean(play("glitches", 200000));
+}
+
+// 25 presses a second on each key in turn, 20ms down and 20ms up with
+// 300us of chatter, then two keys trilled against each other at 30 each
+void test_burst() {
+    bounceMicros = 300;
+    for (uint8_t x = 0; x < numkeys; x++)
+        for (uint32_t n = 0; n < 25; n++) stroke(x, x * 1000000 + n * 40000, x * 1000000 + n * 40000 + 20000);
+    Score s = play("burst 25/s", numkeys * 1000000);
+    assertClean(s);
+    TEST_ASSERT_LESS_OR_EQUAL(contactBound(), s.latMax);
+
+    if (numkeys < 2) return;
+    for (uint32_t n = 0; n < 30; n++) {
+        stroke(0, n * 33333, n * 33333 + 14000);
+        stroke(1, n * 33333 + 16666, n * 33333 + 30666);
+    }
+    assertClean(play("trill 2x30/s", 1000000));
+}
+
+#ifdef MATRIX
+// Every key in a row, then in a column, landing together. The whole pad
+// at once can't be told apart from ghosts, so it isn't tried here; instead
+// three corners of a rectangle mustn't make the fourth show up.
+void test_all_keys() {
+    uint32_t t = 0;
+    for (uint8_t r = 0; r < rows; r++, t += 100000)
+        for (uint8_t c = 0; c < cols; c++) stroke(r * cols + c, t, t + 50000);
+    for (uint8_t c = 0; c < cols; c++, t += 100000)
+        for (uint8_t r = 0; r < rows; r++) stroke(r * cols + c, t, t + 50000);
+    Score s = play("rows and cols", t);
+    assertClean(s);
+    if (rows == cols) TEST_ASSERT_EQUAL_UINT32(rows + cols, together(rows));
+    else TEST_ASSERT_EQUAL_UINT32(rows, together(cols));
+
+    // The first two are reported, the third closes the rectangle and waits
+    stroke(0, 0, 100000);
+    stroke(1, 10000, 100000);
+    stroke(cols, 20000, 100000, false);
+    s = play("rectangle", 100000);
+    TEST_ASSERT_EQUAL_UINT32(0, s.missed);
+    TEST_ASSERT_EQUAL_UINT32(0, s.stuck);
+    TEST_ASSERT_LESS_OR_EQUAL(1, s.phantom);
+}
+#else
+// Every key closing on the same instant goes out in one report, and again
+// with each key chattering its own way
+void test_all_keys() {
+    for (uint32_t n = 0; n < 10; n++)
+        for (uint8_t x = 0; x < numkeys; x++) stroke(x, n * 100000, n * 100000 + 50000);
+    Score s = play("all keys", 1000000);
+    assertClean(s);
+    TEST_ASSERT_EQUAL_UINT32(10, together(numkeys));
+
+    bounceMicros = 1500;
+    for (uint32_t n = 0; n < 10; n++)
+        for (uint8_t x = 0; x < numkeys; x++) stroke(x, n * 100000, n * 100000 + 50000);
+    s = play("all keys chatter", 1000000);
+    assertClean(s);
+    TEST_ASSERT_LESS_OR_EQUAL(contactBound(), s.latMax);
+}
+#endif
+#else
+// Worst case from crossing to report: a sweep of every pad and the one
+// converting when the value crossed, plus a loop
+static const int32_t touchBound = (numkeys + 1) * 400 + 1000;
+
+// Noise at rest never presses, noisy taps are each seen once
+void test_touch_noise() {
+    touchNoise = 24;
+    Score s = play("touch rest", 1000000);
+    assertClean(s);
+    TEST_ASSERT_EQUAL_UINT32(0, s.presses);
+
+    touchNoise = 24;
+    for (uint8_t x = 0; x < numkeys; x++)
+        for (uint32_t n = 0; n < 10; n++) stroke(x, x * 1000000 + n * 100000 + 5000, x * 1000000 + n * 100000 + 45000);
+    s = play("touch noise", numkeys * 1000000);
+    assertClean(s);
+    TEST_ASSERT_LESS_OR_EQUAL(touchBound, s.latMax);
+}
+
+// 20 taps a second on every pad at once
+void test_touch_burst() {
+    touchNoise = 8;
+    for (uint32_t n = 0; n < 20; n++)
+        for (uint8_t x = 0; x < numkeys; x++) stroke(x, n * 50000 + 5000, n * 50000 + 25000);
+    Score s = play("touch burst", 1000000);
+    assertClean(s);
+    TEST_ASSERT_LESS_OR_EQUAL(touchBound, s.latMax);
+}
+
+// The rest level climbs by half the press delta over 20s and comes back,
+// with a tap every second. The baseline follows, so nothing presses on
+// its own and every tap still crosses.
+void test_touch_drift() {
+    touchNoise = 16;
+    touchDrift = touchDelta / 2;
+    for (uint32_t n = 0; n < 20; n++)
+        for (uint8_t x = 0; x < numkeys; x++) stroke(x, n * 1000000 + 500000, n * 1000000 + 560000);
+    Score s = play("touch drift", 20000000);
+    assertClean(s);
+    TEST_ASSERT_LESS_OR_EQUAL(touchBound, s.latMax);
+}
+
+// The same drift over 30s in rapid mode, with the rest level climbing past
+// the release point while every pad is held. The pads stay active after
+// they let go, with the baseline held, until they have been released long
+// enough to go back to rest, or the rest of the climb reads as presses.
+// Taps at the end still press once each.
+void test_touch_drift_rapid() {
+    command(("#set " + perKey("tmode", TOUCH_RAPID) + "\n").c_str());
+    touchNoise = 8;
+    touchDrift = touchDelta / 2;
+    for (uint8_t x = 0; x < numkeys; x++) {
+        stroke(x, 500000, 9000000);
+        for (uint32_t n = 20; n < 30; n++) stroke(x, n * 1000000 + 500000, n * 1000000 + 560000);
+    }
+    Score s = play("touch drift rapid", 30000000);
+    assertClean(s);
+    TEST_ASSERT_LESS_OR_EQUAL(touchBound, s.latMax);
+}
+#endif
+
+// The "#bps all" reply: rate in tenths a second, unstable rate
+static void readRate(unsigned &rate, unsigned &peak, unsigned &unstable) {
+    std::string reply = command("#bps\n", "#bps all");
+    unsigned whole, tenth, peakWhole, peakTenth;
+    TEST_ASSERT_EQUAL(5, sscanf(reply.c_str() + reply.find("#bps all"), "#bps all rate=%u.%u peak=%u.%u ur=%u",
+            &whole, &tenth, &peakWhole, &peakTenth, &unstable));
+    rate = whole * 10 + tenth;
+    peak = peakWhole * 10 + peakTenth;
+}
+
+// Steady taps at 20 a second read as 20, with the peak, and no spread.
+// Alternating 40 and 60ms gaps average the same with an unstable rate of
+// 100 (10ms either way). Once tapping stops the rate drops to nothing.
+void test_rate() {
+    command("#bps reset\n", "#bps all");
+    for (uint32_t n = 0; n < 20; n++) stroke(0, n * 50000 + 5000, n * 50000 + 30000);
+    assertClean(play("rate steady", 1000000));
+    unsigned rate, peak, unstable;
+    readRate(rate, peak, unstable);
+    printf("%-14s %-16s rate %u.%u/s peak %u.%u/s ur %u\n", XSTR(MODEL), "rate steady", rate / 10, rate % 10, peak / 10, peak % 10, unstable);
+    TEST_ASSERT_UINT_WITHIN(5, 200, peak);
+    TEST_ASSERT_LESS_OR_EQUAL(30, unstable);
+
+    uint32_t t = 5000;
+    for (uint32_t n = 0; n < 20; n++, t += n % 2 ? 40000 : 60000) stroke(0, t, t + 25000);
+    // Stop on the last press, before the gap starts to count
+    assertClean(play("rate uneven", t - 60000 + 1000));
+    readRate(rate, peak, unstable);
+    printf("%-14s %-16s rate %u.%u/s peak %u.%u/s ur %u\n", XSTR(MODEL), "rate uneven", rate / 10, rate % 10, peak / 10, peak % 10, unstable);
+    TEST_ASSERT_UINT_WITHIN(10, 200, rate);
+    TEST_ASSERT_UINT_WITHIN(20, 100, unstable);
+
+    for (uint32_t t = 0; t < 1500000; t += stepMicros) { hal::advance(stepMicros); loop(); }
+    readRate(rate, peak, unstable);
+    TEST_ASSERT_EQUAL_UINT32(0, rate);
+
+    // Streaming sends a line while keys are pressed
+    command("#bps on\n", "#bps on");
+    stroke(0, 5000, 30000);
+    play("rate stream", 100000);
+    TEST_ASSERT_TRUE_MESSAGE(hal::serialOutput().find("#bps all") != std::string::npos, "#bps stream");
+    command("#bps off\n", "#bps off");
+}
+
+// The scan timer ticks at the set rate, 4kHz, while keys are played. LED
+// frames sent by show() instead of DMA hold a few ticks up; #scan is
+// there to show it.
+void test_scan() {
+    command("#scan\n", "#scan");
+    for (uint32_t n = 0; n < 10; n++) stroke(0, n * 50000 + 5000, n * 50000 + 30000);
+    assertClean(play("scan", 500000));
+    std::string reply = command("#scan\n", "#scan");
+    unsigned rate, ticks, min, max, late;
+    TEST_ASSERT_EQUAL(5, sscanf(reply.c_str() + reply.find("#scan"), "#scan rate=%u ticks=%u min=%u max=%u late=%u",
+            &rate, &ticks, &min, &max, &late));
+    printf("%-14s %-16s %u ticks, period %u-%u us, %u late\n", XSTR(MODEL), "scan", ticks, min, max, late);
+    TEST_ASSERT_EQUAL_UINT(4, rate);
+    TEST_ASSERT_GREATER_OR_EQUAL(2000, ticks);
+    TEST_ASSERT_LESS_OR_EQUAL(250, min);
+    TEST_ASSERT_GREATER_OR_EQUAL(250, max);
+    TEST_ASSERT_LESS_OR_EQUAL(ticks / 20, late);
+}
+
+// Streaming "#bps on" to a terminal that's closed, then to one that's open
+// but not reading. Nothing is sent without DTR, and once a send to the
+// stalled terminal has timed out the rest of the output is dropped, so
+// taps in both keep their latency.
+void test_console_stall() {
+#ifdef TOUCH
+    int32_t bound = touchBound;
+#else
+    int32_t bound = contactBound();
+#endif
+    command("#bps on\n", "#bps on");
+    hal::setSerialOpen(false);
+    for (uint32_t n = 0; n < 20; n++) stroke(0, n * 50000 + 5000, n * 50000 + 30000);
+    Score s = play("console closed", 1000000);
+    assertClean(s);
+    TEST_ASSERT_LESS_OR_EQUAL(bound, s.latMax);
+
+    hal::setSerialOpen(true);
+    hal::setSerialWritable(0);
+    // A reply to send, which waits out the timeout once
+    hal::serialInput("#get\n");
+    for (uint32_t t = 0; t < 200000; t += stepMicros) { hal::advance(stepMicros); loop(); }
+    for (uint32_t n = 0; n < 20; n++) stroke(0, n * 50000 + 5000, n * 50000 + 30000);
+    s = play("console stalled", 1000000);
+    assertClean(s);
+    TEST_ASSERT_LESS_OR_EQUAL(bound, s.latMax);
+
+    hal::setSerialWritable(63);
+    command("#bps off\n", "#bps off");
+}
+
+int main() {
+    hal::reset();
+    setup();
+    UNITY_BEGIN();
+#ifdef TOUCH
+    RUN_TEST(test_touch_noise);
+    RUN_TEST(test_touch_burst);
+    RUN_TEST(test_touch_drift);
+    RUN_TEST(test_touch_drift_rapid);
+#else
+    RUN_TEST(test_chatter);
+    RUN_TEST(test_chatter_eager);
+    RUN_TEST(test_glitches);
+    RUN_TEST(test_burst);
+    RUN_TEST(test_all_keys);
+#endif
+    RUN_TEST(test_rate);
+    RUN_TEST(test_scan);
+    RUN_TEST(test_console_stall);
+    return UNITY_END();
+}
@@ -0,0 +1,71 @@
+// WS2812 SPI encoding, run with `make test`
+#include <unity.h>
+#include <ws2812.h>
+#include <string.h>
+
+void setUp() {}
+void tearDown() {}
+
+// Decode SPI bits back to bytes the way the LED reads them
+static uint16_t decode(const uint8_t *spi, uint16_t len, uint8_t *out) {
+    uint16_t bytes = 0;
+    uint8_t byte = 0, count = 0;
+    for (uint32_t i = WS2812_LEAD_BYTES * 8; i + 2 < (uint32_t)len * 8; i += 3) {
+        uint8_t b0 = (spi[i / 8] >> (7 - i % 8)) & 1;
+        uint8_t b1 = (spi[(i + 1) / 8] >> (7 - (i + 1) % 8)) & 1;
+        uint8_t b2 = (spi[(i + 2) / 8] >> (7 - (i + 2) % 8)) & 1;
+        if (!b0) break; // Latch
+        TEST_ASSERT_EQUAL_UINT8(0, b2);
+        byte = (byte << 1) | b1;
+        if (++count == 8) { out[bytes++] = byte; count = 0; }
+    }
+    TEST_ASSERT_EQUAL_UINT8(0, count);
+    return bytes;
+}
+
+void test_nibble_table() {
+    for (uint8_t n = 0; n < 16; n++) {
+        uint16_t expected = 0;
+        for (int8_t bit = 3; bit >= 0; bit--) expected = (expected << 3) | 4 | (((n >> bit) & 1) << 1);
+        TEST_ASSERT_EQUAL_HEX16(expected, ws2812Nibble[n]);
+    }
+}
+
+void test_known_bytes() {
+    const uint8_t in[] = { 0x00, 0xff, 0x80 };
+    uint8_t out[WS2812_ENCODED_SIZE(sizeof(in))];
+    memset(out, 0xaa, sizeof(out));
+    TEST_ASSERT_EQUAL_UINT16(sizeof(out), ws2812Encode(in, sizeof(in), out));
+    const uint8_t expected[] = {
+        0x00,             // Lead
+        0x92, 0x49, 0x24, // 00000000
+        0xdb, 0x6d, 0xb6, // 11111111
+        0xd2, 0x49, 0x24, // 10000000
+    };
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, sizeof(expected));
+    for (uint16_t x = sizeof(expected); x < sizeof(out); x++) TEST_ASSERT_EQUAL_HEX8(0, out[x]);
+}
+
+void test_round_trip() {
+    uint8_t in[256];
+    for (uint16_t x = 0; x < 256; x++) in[x] = x;
+    static uint8_t out[WS2812_ENCODED_SIZE(256)];
+    uint8_t back[256];
+    uint16_t len = ws2812Encode(in, 256, out);
+    TEST_ASSERT_EQUAL_UINT16(256, decode(out, len, back));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(in, back, 256);
+}
+
+void test_latch_time() {
+    // WS2812B needs the line low for 280us to latch
+    TEST_ASSERT_GREATER_OR_EQUAL(280, WS2812_LATCH_BYTES * 8 * 1000000ull / WS2812_SPI_HZ);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_nibble_table);
+    RUN_TEST(test_known_bytes);
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_latch_time);
+    return UNITY_END();
+}
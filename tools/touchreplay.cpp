@@ -0,0 +1,157 @@
+// Replay a touch capture offline
+// Runs the raw samples from "#cap" (see src/capture.h) through the same
+// touch.h press and release logic as checkKeys(), with the thresholds,
+// reset value and press modes from the capture or any others, and lists
+// every press.
+// Presses shorter than the minimum, or starting less than the minimum
+// after the last release, are counted as false triggers.
+//
+//   make tools/touchreplay
+//   tools/touchreplay capture.bin [-t 120,120,200,150] [-r 12] [-m 20] [-q]
+//       [-M 1,1,0,0] [-a 10,10,10,10]
+//
+// -M sets each pad's press mode (0 level, 1 rapid, 2 slope) and -a the
+// delta for the rapid modes, see src/touch.h.
+//
+// Grab a capture with the terminal in raw mode, e.g. on Linux:
+//   stty -F /dev/ttyACM0 raw; cat /dev/ttyACM0 > capture.bin &
+//   printf '#cap\n' > /dev/ttyACM0
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <touch.h>
+
+static void usage() {
+    fprintf(stderr, "usage: touchreplay capture [-t thresholds] [-r reset] [-m min_ms] [-q] [-M modes] [-a rapid]\n");
+    exit(2);
+}
+
+// Parse "a,b,c" into values, returns how many there were
+static size_t parseList(const char *s, std::vector<int> &values) {
+    values.clear();
+    while (*s && *s != ' ' && *s != '\r' && *s != '\n') {
+        values.push_back(strtol(s, (char **)&s, 10));
+        if (*s == ',') s++;
+    }
+    return values.size();
+}
+
+// Value of "name=" in the header line, or NULL
+static const char *field(const std::string &header, const char *name) {
+    std::string key = std::string(" ") + name + "=";
+    size_t at = header.find(key);
+    return at == std::string::npos ? NULL : header.c_str() + at + key.size();
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) usage();
+    std::vector<int> thresh, base, modes, rapid;
+    int reset = -1;
+    double minMs = 20;
+    bool quiet = false;
+    const char *thresholds = NULL, *modeList = NULL, *rapidList = NULL;
+    for (int x=2; x<argc; x++) {
+        if (!strcmp(argv[x], "-t") && x+1 < argc) thresholds = argv[++x];
+        else if (!strcmp(argv[x], "-r") && x+1 < argc) reset = atoi(argv[++x]);
+        else if (!strcmp(argv[x], "-m") && x+1 < argc) minMs = atof(argv[++x]);
+        else if (!strcmp(argv[x], "-q")) quiet = true;
+        else if (!strcmp(argv[x], "-M") && x+1 < argc) modeList = argv[++x];
+        else if (!strcmp(argv[x], "-a") && x+1 < argc) rapidList = argv[++x];
+        else usage();
+    }
+
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) { perror(argv[1]); return 1; }
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) data.insert(data.end(), chunk, chunk + n);
+    fclose(f);
+
+    // Find the header, the records start on the next line
+    std::string text(data.begin(), data.end());
+    size_t start = text.find("#cap pads=");
+    if (start == std::string::npos) { fprintf(stderr, "no #cap header in %s\n", argv[1]); return 1; }
+    size_t eol = text.find('\n', start);
+    if (eol == std::string::npos) { fprintf(stderr, "header cut short\n"); return 1; }
+    std::string header = " " + text.substr(start + 5, eol - start - 5);
+    int pads = atoi(field(header, "pads"));
+    if (pads < 1 || !field(header, "sweeps")) { fprintf(stderr, "bad header\n"); return 1; }
+    long sweeps = atol(field(header, "sweeps"));
+    if (reset < 0) reset = field(header, "reset") ? atoi(field(header, "reset")) : 12;
+    if (thresholds) parseList(thresholds, thresh);
+    else if (field(header, "thresh")) parseList(field(header, "thresh"), thresh);
+    if (field(header, "base")) parseList(field(header, "base"), base);
+    if ((int)thresh.size() != pads) { fprintf(stderr, "need %d thresholds\n", pads); return 1; }
+    // Captures from before the rapid modes are all level
+    if (modeList) parseList(modeList, modes);
+    else if (field(header, "tmode")) parseList(field(header, "tmode"), modes);
+    else modes.assign(pads, TOUCH_LEVEL);
+    if (rapidList) parseList(rapidList, rapid);
+    else if (field(header, "rapid")) parseList(field(header, "rapid"), rapid);
+    else rapid.assign(pads, 10);
+    if ((int)modes.size() != pads || (int)rapid.size() != pads) {
+        fprintf(stderr, "need %d modes and rapid deltas\n", pads);
+        return 1;
+    }
+
+    size_t record = (pads + 1) * 2;
+    const uint8_t *p = &data[eol + 1];
+    if ((size_t)(data.size() - eol - 1) < sweeps * record) {
+        sweeps = (data.size() - eol - 1) / record;
+        fprintf(stderr, "capture cut short, replaying %ld sweeps\n", sweeps);
+    }
+
+    std::vector<TouchPad> pad(pads);
+    std::vector<bool> down(pads);
+    std::vector<double> pressed(pads), released(pads, -1e9);
+    std::vector<int> presses(pads), falses(pads);
+    std::vector<double> shortest(pads, 1e9), longest(pads);
+    for (int x=0; x<pads; x++) {
+        memset(&pad[x], 0, sizeof(pad[x]));
+        // Start from the baseline the firmware had, if the capture has it
+        if ((int)base.size() == pads) {
+            pad[x].baseline = (int32_t)base[x] << 16;
+            pad[x].seeded = true;
+        }
+        touchCapture(pad[x], thresh[x], reset);
+        touchMode(pad[x], modes[x], rapid[x]);
+    }
+
+    double us = 0;
+    for (long s=0; s<sweeps; s++, p += record) {
+        us += p[0] | p[1] << 8;
+        for (int x=0; x<pads; x++) {
+            uint16_t raw = p[2 + x*2] | p[3 + x*2] << 8;
+            bool held = touchUpdate(pad[x], touchValue(raw), down[x], reset);
+            if (held == down[x]) continue;
+            down[x] = held;
+            double ms = us / 1000;
+            if (held) {
+                pressed[x] = ms;
+                continue;
+            }
+            double length = ms - pressed[x];
+            bool chatter = pressed[x] - released[x] < minMs;
+            bool tooShort = length < minMs;
+            presses[x]++;
+            if (chatter || tooShort) falses[x]++;
+            if (length < shortest[x]) shortest[x] = length;
+            if (length > longest[x]) longest[x] = length;
+            released[x] = ms;
+            if (!quiet) printf("pad %d: %9.2f ms for %7.2f ms%s%s\n", x+1, pressed[x], length,
+                tooShort ? " (short)" : "", chatter ? " (chatter)" : "");
+        }
+    }
+
+    printf("%ld sweeps, %.1f ms, reset %d, minimum %.1f ms\n", sweeps, us / 1000, reset, minMs);
+    for (int x=0; x<pads; x++) {
+        printf("pad %d: threshold %3d, mode %d, %d presses, %d false", x+1, thresh[x], modes[x], presses[x], falses[x]);
+        if (presses[x]) printf(", %.2f-%.2f ms", shortest[x], longest[x]);
+        if (down[x]) printf(", still held");
+        printf("\n");
+    }
+    return 0;
+}